@@ -0,0 +1,226 @@
+#include "devices/hrtimer.h"
+#include <debug.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include "devices/lapic.h"
+#include "devices/timer.h"
+#include "threads/interrupt.h"
+#include "threads/softirq.h"
+#include "threads/thread.h"
+#include "intrinsic.h"
+
+/* Sleeps shorter than this spin on the TSC instead: blocking and
+   being woken up again costs about as much. */
+#define HRTIMER_SPIN_NS 5000
+
+/* Pending timers, soonest first.  Interrupts must be off to touch
+   the tree. */
+static struct rb_tree pending;
+
+static bool initialized;        /* hrtimer_init() done? */
+static bool use_lapic;          /* Local APIC timer interrupts at deadlines? */
+
+/* Runs expired timers' functions. */
+static struct softirq_work expire_work;
+
+static rb_less_func expires_before;
+static intr_handler_func hrtimer_interrupt;
+static softirq_func hrtimer_expire;
+static hrtimer_func wake_thread;
+static void reprogram (void);
+
+/* Initializes high-resolution timers.  timer_calibrate() must
+   already have measured the TSC. */
+void
+hrtimer_init (void) {
+	const char *source = "timer ticks";
+
+	rb_init (&pending, expires_before, NULL);
+	softirq_work_init (&expire_work, hrtimer_expire, NULL);
+
+	if (lapic_present ()) {
+		intr_register_ext (LAPIC_TIMER_VEC, hrtimer_interrupt, "LAPIC timer");
+		use_lapic = lapic_timer_init ();
+		if (use_lapic)
+			source = lapic_timer_has_deadline () ? "local APIC TSC-deadline"
+				: "local APIC one-shot";
+	}
+	initialized = true;
+
+	printf ("High-resolution timers: %s, TSC at %'"PRIu64" Hz.\n",
+			source, timer_tsc_hz ());
+}
+
+/* Initializes T to call FUNC(AUX) when it expires. */
+void
+hrtimer_setup (struct hrtimer *t, hrtimer_func *func, void *aux) {
+	ASSERT (t != NULL);
+	ASSERT (func != NULL);
+
+	t->func = func;
+	t->aux = aux;
+	t->pending = false;
+}
+
+/* Arms T to expire at EXPIRES, replacing any earlier expiry.  An
+   expiry in the past makes T expire as soon as possible, but
+   never before this function returns. */
+void
+hrtimer_start (struct hrtimer *t, int64_t expires) {
+	enum intr_level old_level;
+
+	ASSERT (initialized);
+
+	old_level = intr_disable ();
+	if (t->pending)
+		rb_remove (&pending, &t->elem);
+	t->expires = expires;
+	t->pending = true;
+	rb_insert (&pending, &t->elem);
+	if (rb_min (&pending) == &t->elem)
+		reprogram ();
+	intr_set_level (old_level);
+}
+
+/* Disarms T.  Returns true if it was pending, false if it had
+   already expired or was never started. */
+bool
+hrtimer_cancel (struct hrtimer *t) {
+	enum intr_level old_level = intr_disable ();
+	bool was_pending = t->pending;
+
+	if (was_pending) {
+		bool was_first = rb_min (&pending) == &t->elem;
+
+		rb_remove (&pending, &t->elem);
+		t->pending = false;
+		if (was_first)
+			reprogram ();
+	}
+	intr_set_level (old_level);
+	return was_pending;
+}
+
+/* Blocks the running thread for NS nanoseconds.  Very short
+   sleeps spin instead.  Returns false, without waiting, if
+   hrtimer_init() has not run yet. */
+bool
+hrtimer_sleep (int64_t ns) {
+	struct hrtimer timer;
+	enum intr_level old_level;
+	int64_t deadline;
+
+	ASSERT (!intr_context ());
+	ASSERT (intr_get_level () == INTR_ON);
+
+	if (!initialized)
+		return false;
+
+	deadline = timer_ns () + ns;
+	if (ns < HRTIMER_SPIN_NS) {
+		while (timer_ns () < deadline)
+			barrier ();
+		return true;
+	}
+
+	hrtimer_setup (&timer, wake_thread, thread_current ());
+	old_level = intr_disable ();
+	hrtimer_start (&timer, deadline);
+	thread_block ();
+	intr_set_level (old_level);
+	return true;
+}
+
+/* Called by the timer interrupt handler on every tick.  Without
+   the local APIC timer, this is where timers expire. */
+void
+hrtimer_tick (void) {
+	struct rb_elem *e;
+
+	ASSERT (intr_context ());
+
+	if (!initialized || use_lapic)
+		return;
+	e = rb_min (&pending);
+	if (e != NULL
+			&& rb_entry (e, struct hrtimer, elem)->expires <= timer_ns ())
+		softirq_queue (&expire_work, SOFTIRQ_HI);
+}
+
+/* Returns true if some timer will only expire on a timer tick, so
+   the tick must not be stopped.  Interrupts must be off. */
+bool
+hrtimer_needs_tick (void) {
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	return initialized && !use_lapic && !rb_empty (&pending);
+}
+
+/* Orders timers by expiry time. */
+static bool
+expires_before (const struct rb_elem *a_, const struct rb_elem *b_,
+		void *aux UNUSED) {
+	const struct hrtimer *a = rb_entry (a_, struct hrtimer, elem);
+	const struct hrtimer *b = rb_entry (b_, struct hrtimer, elem);
+
+	return a->expires < b->expires;
+}
+
+/* Local APIC timer interrupt handler. */
+static void
+hrtimer_interrupt (struct intr_frame *f UNUSED) {
+	softirq_queue (&expire_work, SOFTIRQ_HI);
+}
+
+/* Runs the function of every timer that had expired when we
+   started, soonest first, then arms the local APIC timer for the
+   next one.  Timers re-armed by their own functions wait for the
+   next run, so this always terminates. */
+static void
+hrtimer_expire (void *aux UNUSED) {
+	int64_t now = timer_ns ();
+
+	for (;;) {
+		enum intr_level old_level = intr_disable ();
+		struct rb_elem *e = rb_min (&pending);
+		struct hrtimer *t = NULL;
+
+		if (e != NULL && rb_entry (e, struct hrtimer, elem)->expires <= now) {
+			t = rb_entry (e, struct hrtimer, elem);
+			rb_remove (&pending, e);
+			t->pending = false;
+		} else
+			reprogram ();
+		intr_set_level (old_level);
+
+		if (t == NULL)
+			break;
+		t->func (t->aux);
+	}
+}
+
+/* Wakes up the thread sleeping in hrtimer_sleep(). */
+static void
+wake_thread (void *t) {
+	thread_unblock (t);
+	check_preemption ();
+}
+
+/* Arms the local APIC timer for the soonest pending timer, or
+   disarms it if there is none.  Interrupts must be off. */
+static void
+reprogram (void) {
+	struct rb_elem *e;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (!use_lapic)
+		return;
+	e = rb_min (&pending);
+	if (e == NULL)
+		lapic_timer_disarm ();
+	else {
+		int64_t delta = rb_entry (e, struct hrtimer, elem)->expires - timer_ns ();
+		lapic_timer_arm (rdtsc () + timer_ns_to_tsc (delta > 0 ? delta : 0));
+	}
+}
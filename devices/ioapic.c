@@ -0,0 +1,308 @@
+#include "devices/ioapic.h"
+#include <debug.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/interrupt.h"
+#include "threads/mmu.h"
+#include "threads/vaddr.h"
+
+/* I/O APIC.  See [82093AA] and [ACPI] 5.2.12 "Multiple APIC
+   Description Table (MADT)".
+
+   The I/O APIC replaces the 8259A PICs.  Each of its input pins
+   has a redirection entry that names the vector to raise and the
+   local APIC to raise it on, and the interrupt is delivered as a
+   message rather than through LINT0.  ISA IRQ N is wired to pin N
+   unless the firmware's MADT lists an override; on nearly every
+   PC the PIT's IRQ 0 sits on pin 2.
+
+   Only the I/O APIC that serves the ISA IRQs (the one whose pins
+   start at global system interrupt 0) is used. */
+
+/* Registers, reached by writing their index to IOREGSEL and then
+   accessing IOWIN. */
+#define IOREGSEL 0x00                   /* Register select (byte offset). */
+#define IOWIN 0x10                      /* Register window (byte offset). */
+#define REG_VER 0x01                    /* Version and last pin. */
+#define REG_REDTBL 0x10                 /* Pin N's entry at 0x10 + 2N. */
+
+/* Redirection entry, low dword.  The vector is in bits 0...7;
+   the delivery mode (fixed) and destination mode (physical) are
+   0.  The high dword holds the destination APIC ID in bits
+   24...31. */
+#define RTE_ACTIVE_LOW 0x2000           /* Polarity: active low. */
+#define RTE_LEVEL 0x8000                /* Trigger mode: level. */
+#define RTE_MASKED 0x10000              /* Interrupt masked. */
+
+#define IOAPIC_DEFAULT_BASE 0xfec00000  /* Where chipsets put it. */
+#define ISA_IRQ_CNT 16
+
+/* How an ISA IRQ reaches the I/O APIC. */
+struct isa_route {
+	uint32_t pin;                       /* I/O APIC input pin. */
+	uint32_t flags;                     /* RTE_ACTIVE_LOW, RTE_LEVEL. */
+};
+
+/* Mapped registers, or NULL if there is no I/O APIC. */
+static volatile uint32_t *ioapic;
+static uint32_t pin_cnt;
+static struct isa_route isa_routes[ISA_IRQ_CNT];
+
+/* ACPI Root System Description Pointer.  ACPI 2.0 appends more
+   fields, but the RSDT it points to is enough for us. */
+struct acpi_rsdp {
+	char signature[8];                  /* "RSD PTR ". */
+	uint8_t checksum;                   /* Of these 20 bytes. */
+	char oem_id[6];
+	uint8_t revision;
+	uint32_t rsdt_addr;                 /* Physical address of the RSDT. */
+} __attribute__((packed));
+
+/* Header common to every ACPI table. */
+struct acpi_header {
+	char signature[4];
+	uint32_t length;                    /* Including this header. */
+	uint8_t revision;
+	uint8_t checksum;                   /* Of the whole table. */
+	char oem_id[6];
+	char oem_table_id[8];
+	uint32_t oem_revision;
+	uint32_t creator_id;
+	uint32_t creator_revision;
+} __attribute__((packed));
+
+/* Multiple APIC Description Table, signature "APIC".  A list of
+   variable-length entries follows. */
+struct acpi_madt {
+	struct acpi_header header;
+	uint32_t lapic_addr;
+	uint32_t flags;
+} __attribute__((packed));
+
+#define MADT_IOAPIC 1                   /* struct madt_ioapic. */
+#define MADT_OVERRIDE 2                 /* struct madt_override. */
+
+struct madt_entry {
+	uint8_t type;
+	uint8_t length;
+} __attribute__((packed));
+
+struct madt_ioapic {
+	struct madt_entry entry;
+	uint8_t id;
+	uint8_t reserved;
+	uint32_t addr;                      /* Register base. */
+	uint32_t gsi_base;                  /* GSI of pin 0. */
+} __attribute__((packed));
+
+struct madt_override {
+	struct madt_entry entry;
+	uint8_t bus;                        /* 0: ISA. */
+	uint8_t source;                     /* ISA IRQ. */
+	uint32_t gsi;                       /* Where it really arrives. */
+	uint16_t flags;                     /* MPS INTI flags. */
+} __attribute__((packed));
+
+static const struct acpi_madt *madt_find (void);
+static uint64_t madt_parse (const struct acpi_madt *);
+static uint32_t ioapic_read (uint32_t reg);
+static void ioapic_write (uint32_t reg, uint32_t value);
+
+/* Finds the I/O APIC through the ACPI MADT, or at its customary
+   address if there is no MADT, and masks all of its pins.
+   Returns false if there is no I/O APIC. */
+bool
+ioapic_init (void) {
+	const struct acpi_madt *madt;
+	uint64_t base = IOAPIC_DEFAULT_BASE;
+	uint32_t ver, pin;
+	int irq;
+
+	for (irq = 0; irq < ISA_IRQ_CNT; irq++)
+		isa_routes[irq] = (struct isa_route) { .pin = irq, .flags = 0 };
+
+	madt = madt_find ();
+	if (madt != NULL)
+		base = madt_parse (madt);
+	else
+		isa_routes[0].pin = 2;
+	if (base == 0)
+		return false;
+
+	ioapic = pml4_map_phys (base, PGSIZE, true);
+	if (ioapic == NULL)
+		return false;
+	ver = ioapic_read (REG_VER);
+	if (ver == UINT32_MAX) {
+		/* Nothing answered at that address. */
+		ioapic = NULL;
+		return false;
+	}
+	pin_cnt = ((ver >> 16) & 0xff) + 1;
+	for (pin = 0; pin < pin_cnt; pin++)
+		ioapic_write (REG_REDTBL + 2 * pin, RTE_MASKED);
+
+	printf ("I/O APIC at %#"PRIx64" with %"PRIu32" pins%s, IRQ 0 on pin %"PRIu32".\n",
+			base, pin_cnt, madt != NULL ? "" : " (no ACPI MADT)",
+			isa_routes[0].pin);
+	return true;
+}
+
+/* Directs ISA IRQ to raise vector VEC on the local APIC whose ID
+   is DEST, and unmasks it.  Returns false if the IRQ is wired to
+   a pin this I/O APIC lacks. */
+bool
+ioapic_route (int irq, uint8_t vec, uint8_t dest) {
+	const struct isa_route *r;
+	enum intr_level old_level;
+
+	ASSERT (ioapic != NULL);
+	ASSERT (irq >= 0 && irq < ISA_IRQ_CNT);
+
+	r = &isa_routes[irq];
+	if (r->pin >= pin_cnt)
+		return false;
+
+	/* IOREGSEL and IOWIN are a pair; nothing may come between. */
+	old_level = intr_disable ();
+	ioapic_write (REG_REDTBL + 2 * r->pin + 1, (uint32_t) dest << 24);
+	ioapic_write (REG_REDTBL + 2 * r->pin, vec | r->flags);
+	intr_set_level (old_level);
+	return true;
+}
+
+/* Returns true if the SIZE bytes at P sum to 0 mod 256, as every
+   ACPI structure's do. */
+static bool
+checksum_ok (const void *p, size_t size) {
+	const uint8_t *b = p;
+	uint8_t sum = 0;
+
+	while (size-- > 0)
+		sum += *b++;
+	return sum == 0;
+}
+
+/* Searches the SIZE bytes of physical memory at START, which
+   must already be mapped, for the RSDP.  It is 16-byte aligned. */
+static const struct acpi_rsdp *
+rsdp_scan (uint64_t start, size_t size) {
+	uint64_t pa;
+
+	for (pa = start; pa + sizeof (struct acpi_rsdp) <= start + size; pa += 16) {
+		const struct acpi_rsdp *rsdp = ptov (pa);
+		if (!memcmp (rsdp->signature, "RSD PTR ", 8)
+				&& checksum_ok (rsdp, sizeof *rsdp))
+			return rsdp;
+	}
+	return NULL;
+}
+
+/* Maps the ACPI table at physical address PA and returns it, or
+   returns a null pointer if its checksum is wrong. */
+static const struct acpi_header *
+acpi_map_table (uint64_t pa) {
+	const struct acpi_header *h = pml4_map_phys (pa, sizeof *h, false);
+
+	if (h == NULL || h->length < sizeof *h
+			|| pml4_map_phys (pa, h->length, false) == NULL
+			|| !checksum_ok (h, h->length))
+		return NULL;
+	return h;
+}
+
+/* Returns the MADT, or a null pointer if the firmware has none.
+   The RSDP lies in the first KB of the Extended BIOS Data Area,
+   whose segment the BIOS leaves at 0x40e, or in the BIOS ROM
+   between 0xe0000 and 0xfffff; see [ACPI] 5.2.5.1.
+
+   palloc never hands out ACPI reclaimable memory, so the tables
+   are still intact here. */
+static const struct acpi_madt *
+madt_find (void) {
+	const struct acpi_rsdp *rsdp;
+	const struct acpi_header *rsdt;
+	const uint32_t *tables;
+	uint64_t ebda;
+	size_t i, cnt;
+
+	ebda = (uint64_t) *(uint16_t *) ptov (0x40e) << 4;
+	rsdp = ebda != 0 ? rsdp_scan (ebda, 1024) : NULL;
+	if (rsdp == NULL)
+		rsdp = rsdp_scan (0xe0000, 0x20000);
+	if (rsdp == NULL)
+		return NULL;
+
+	rsdt = acpi_map_table (rsdp->rsdt_addr);
+	if (rsdt == NULL || memcmp (rsdt->signature, "RSDT", 4))
+		return NULL;
+	tables = (const uint32_t *) (rsdt + 1);
+	cnt = (rsdt->length - sizeof *rsdt) / sizeof *tables;
+	for (i = 0; i < cnt; i++) {
+		const struct acpi_header *h = acpi_map_table (tables[i]);
+		if (h != NULL && !memcmp (h->signature, "APIC", 4))
+			return (const struct acpi_madt *) h;
+	}
+	return NULL;
+}
+
+/* Converts MPS INTI FLAGS into redirection entry bits.  A field
+   of 0 means "as the bus says", which for ISA is active high and
+   edge triggered. */
+static uint32_t
+inti_flags (uint16_t flags) {
+	uint32_t rte = 0;
+
+	if ((flags & 0x3) == 0x3)
+		rte |= RTE_ACTIVE_LOW;
+	if (((flags >> 2) & 0x3) == 0x3)
+		rte |= RTE_LEVEL;
+	return rte;
+}
+
+/* Reads the ISA IRQ overrides out of MADT into isa_routes and
+   returns the register base of the I/O APIC serving GSI 0, or 0
+   if the MADT lists none. */
+static uint64_t
+madt_parse (const struct acpi_madt *madt) {
+	const uint8_t *p = (const uint8_t *) (madt + 1);
+	const uint8_t *end = (const uint8_t *) madt + madt->header.length;
+	uint64_t base = 0;
+
+	while (p + sizeof (struct madt_entry) <= end) {
+		const struct madt_entry *e = (const struct madt_entry *) p;
+
+		if (e->length < sizeof *e || p + e->length > end)
+			break;
+		if (e->type == MADT_IOAPIC && e->length >= sizeof (struct madt_ioapic)) {
+			const struct madt_ioapic *io = (const struct madt_ioapic *) e;
+			if (io->gsi_base == 0)
+				base = io->addr;
+		} else if (e->type == MADT_OVERRIDE
+				&& e->length >= sizeof (struct madt_override)) {
+			const struct madt_override *o = (const struct madt_override *) e;
+			if (o->bus == 0 && o->source < ISA_IRQ_CNT)
+				isa_routes[o->source] = (struct isa_route) {
+					.pin = o->gsi,
+					.flags = inti_flags (o->flags),
+				};
+		}
+		p += e->length;
+	}
+	return base;
+}
+
+/* Returns the value of I/O APIC register REG. */
+static uint32_t
+ioapic_read (uint32_t reg) {
+	ioapic[IOREGSEL / sizeof *ioapic] = reg;
+	return ioapic[IOWIN / sizeof *ioapic];
+}
+
+/* Sets I/O APIC register REG to VALUE. */
+static void
+ioapic_write (uint32_t reg, uint32_t value) {
+	ioapic[IOREGSEL / sizeof *ioapic] = reg;
+	ioapic[IOWIN / sizeof *ioapic] = value;
+}
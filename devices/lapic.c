@@ -0,0 +1,224 @@
+#include "devices/lapic.h"
+#include <debug.h>
+#include <stdio.h>
+#include "devices/timer.h"
+#include "threads/interrupt.h"
+#include "threads/mmu.h"
+#include "threads/vaddr.h"
+#include "intrinsic.h"
+
+/* Local APIC.  See [IA32-v3a] chapter 10 "Advanced Programmable
+   Interrupt Controller (APIC)".
+
+   Device interrupts arrive from the I/O APIC (ioapic.c) as
+   messages, or, with the PIC fallback, from the 8259A PICs through
+   the local APIC's LINT0 pin in "virtual wire" mode.  Either way
+   they are acknowledged here, and the task priority register
+   holds off the less urgent ones.  The local APIC timer can
+   interrupt at an arbitrary TSC deadline instead of only on PIT
+   ticks. */
+
+/* Registers, as byte offsets into the local APIC page. */
+#define REG_ID 0x020                    /* Local APIC ID. */
+#define REG_TPR 0x080                   /* Task Priority. */
+#define REG_EOI 0x0b0                   /* End Of Interrupt. */
+#define REG_SVR 0x0f0                   /* Spurious Interrupt Vector. */
+#define REG_LVT_TIMER 0x320             /* LVT Timer. */
+#define REG_LVT_LINT0 0x350             /* LVT LINT0. */
+#define REG_LVT_LINT1 0x360             /* LVT LINT1. */
+#define REG_TIMER_INIT 0x380            /* Timer Initial Count. */
+#define REG_TIMER_CUR 0x390             /* Timer Current Count. */
+#define REG_TIMER_DIV 0x3e0             /* Timer Divide Configuration. */
+
+#define SVR_ENABLE 0x100                /* APIC software enable. */
+#define LVT_MASKED 0x10000              /* Interrupt masked. */
+#define LVT_NMI 0x400                   /* Delivery mode NMI. */
+#define LVT_EXTINT 0x700                /* Delivery mode ExtINT (8259A). */
+#define LVT_TSC_DEADLINE 0x40000        /* Timer mode TSC-deadline. */
+#define TIMER_DIV_16 0x3                /* Timer counts at bus clock / 16. */
+
+/* Model-specific registers. */
+#define MSR_APIC_BASE 0x1b              /* Local APIC base address. */
+#define APIC_BASE_ENABLE 0x800          /* Global enable bit in MSR_APIC_BASE. */
+#define MSR_TSC_DEADLINE 0x6e0          /* TSC-deadline timer target. */
+
+/* CPUID leaf 1 feature bits. */
+#define CPUID_EDX_APIC (1u << 9)
+#define CPUID_ECX_TSC_DEADLINE (1u << 24)
+
+/* Mapped local APIC registers, or NULL if there is no local APIC. */
+static volatile uint32_t *lapic;
+
+/* Timer state.  With TSC-deadline support the timer is armed by
+   writing a TSC value to an MSR.  Otherwise it runs in one-shot
+   mode, counting down at TIMER_HZ, measured against the TSC. */
+static bool timer_ready;
+static bool timer_deadline;
+static uint64_t timer_hz;
+
+static uint32_t lapic_read (int reg);
+static void lapic_write (int reg, uint32_t value);
+
+/* Finds, maps and enables the local APIC.  Returns false, leaving
+   everything untouched, if the CPU has none.  Calling it again
+   just reports whether the first call succeeded. */
+bool
+lapic_init (void) {
+	uint32_t r[4];
+	uint64_t msr, base;
+
+	if (lapic != NULL)
+		return true;
+	cpuid (1, r);
+	if (!(r[3] & CPUID_EDX_APIC))
+		return false;
+	msr = read_msr (MSR_APIC_BASE);
+	if (!(msr & APIC_BASE_ENABLE))
+		return false;
+
+	/* Map the register page uncached at its usual place in the
+	   kernel's physical memory window.  The kernel half of every
+	   page table shares base_pml4's lower levels, so processes see
+	   it too. */
+	base = msr & 0x000ffffffffff000ULL;
+	lapic = pml4_map_phys (base, PGSIZE, true);
+	if (lapic == NULL)
+		return false;
+
+	/* Keep the PICs wired to LINT0 until the I/O APIC takes over,
+	   NMIs to LINT1, accept every priority, and turn the APIC on. */
+	lapic_write (REG_LVT_LINT0, LVT_EXTINT);
+	lapic_write (REG_LVT_LINT1, LVT_NMI);
+	lapic_write (REG_LVT_TIMER, LVT_MASKED | LAPIC_TIMER_VEC);
+	lapic_write (REG_TPR, 0);
+	lapic_write (REG_SVR, SVR_ENABLE | LAPIC_SPURIOUS_VEC);
+	return true;
+}
+
+/* Returns true if lapic_init() found a local APIC. */
+bool
+lapic_present (void) {
+	return lapic != NULL;
+}
+
+/* Returns this CPU's local APIC ID, the destination the I/O APIC
+   needs to reach it. */
+uint8_t
+lapic_id (void) {
+	return lapic_read (REG_ID) >> 24;
+}
+
+/* Disconnects the 8259A PICs from LINT0, once the I/O APIC
+   delivers device interrupts instead. */
+void
+lapic_mask_extint (void) {
+	lapic_write (REG_LVT_LINT0, LVT_MASKED | LVT_EXTINT);
+}
+
+/* Acknowledges the local APIC interrupt being handled. */
+void
+lapic_eoi (void) {
+	lapic_write (REG_EOI, 0);
+}
+
+/* Sets up the local APIC timer, disarmed, measuring how fast it
+   counts if it has to.  The caller must register a handler for
+   LAPIC_TIMER_VEC first.  Returns false if there is no usable
+   timer. */
+bool
+lapic_timer_init (void) {
+	uint32_t r[4];
+
+	if (lapic == NULL || timer_tsc_hz () == 0)
+		return false;
+
+	cpuid (1, r);
+	timer_deadline = (r[2] & CPUID_ECX_TSC_DEADLINE) != 0;
+	if (timer_deadline) {
+		/* The LVT write must land before the first deadline is
+		   written to the MSR; see [IA32-v3a] 10.5.4.1. */
+		write_msr (MSR_TSC_DEADLINE, 0);
+		lapic_write (REG_LVT_TIMER, LVT_TSC_DEADLINE | LAPIC_TIMER_VEC);
+		asm volatile ("mfence" : : : "memory");
+	} else {
+		/* Count down from the top for a millisecond of TSC time,
+		   which timer_calibrate() measured against the PIT. */
+		uint64_t tsc_ms = timer_tsc_hz () / 1000;
+		uint64_t start;
+		uint32_t elapsed;
+
+		lapic_write (REG_LVT_TIMER, LVT_MASKED | LAPIC_TIMER_VEC);
+		lapic_write (REG_TIMER_DIV, TIMER_DIV_16);
+		start = rdtsc ();
+		lapic_write (REG_TIMER_INIT, UINT32_MAX);
+		while (rdtsc () - start < tsc_ms)
+			continue;
+		elapsed = UINT32_MAX - lapic_read (REG_TIMER_CUR);
+		lapic_write (REG_TIMER_INIT, 0);
+		if (elapsed == 0)
+			return false;
+		timer_hz = (uint64_t) elapsed * 1000;
+		lapic_write (REG_LVT_TIMER, LAPIC_TIMER_VEC);
+	}
+	timer_ready = true;
+	return true;
+}
+
+/* Returns true if the timer is armed with TSC deadlines rather
+   than a down-counter. */
+bool
+lapic_timer_has_deadline (void) {
+	return timer_deadline;
+}
+
+/* Arms the timer to interrupt once, at TSC value DEADLINE_TSC or
+   as soon as possible if that has passed.  Replaces any earlier
+   deadline.  Interrupts must be off. */
+void
+lapic_timer_arm (uint64_t deadline_tsc) {
+	ASSERT (intr_get_level () == INTR_OFF);
+	ASSERT (timer_ready);
+
+	if (timer_deadline)
+		write_msr (MSR_TSC_DEADLINE, deadline_tsc != 0 ? deadline_tsc : 1);
+	else {
+		uint64_t now = rdtsc ();
+		uint64_t count = 1;
+
+		if (deadline_tsc > now) {
+			uint64_t ns = timer_tsc_to_ns (deadline_tsc - now);
+			count = (ns / 1000000000) * timer_hz
+				+ (ns % 1000000000) * timer_hz / 1000000000;
+			if (count == 0)
+				count = 1;
+			else if (count > UINT32_MAX)
+				count = UINT32_MAX;
+		}
+		lapic_write (REG_TIMER_INIT, count);
+	}
+}
+
+/* Cancels any pending timer interrupt.  Interrupts must be off. */
+void
+lapic_timer_disarm (void) {
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (!timer_ready)
+		return;
+	if (timer_deadline)
+		write_msr (MSR_TSC_DEADLINE, 0);
+	else
+		lapic_write (REG_TIMER_INIT, 0);
+}
+
+/* Returns the value of local APIC register REG. */
+static uint32_t
+lapic_read (int reg) {
+	return lapic[reg / sizeof *lapic];
+}
+
+/* Sets local APIC register REG to VALUE. */
+static void
+lapic_write (int reg, uint32_t value) {
+	lapic[reg / sizeof *lapic] = value;
+}
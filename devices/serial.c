@@ -5,6 +5,7 @@
 #include "devices/timer.h"
 #include "threads/io.h"
 #include "threads/interrupt.h"
+#include "threads/softirq.h"
 #include "threads/synch.h"
 #include "threads/thread.h"
 
@@ -54,10 +55,14 @@ static enum { UNINIT, POLL, QUEUE } mode;
 /* Data to be transmitted. */
 static struct intq txq;
 
+/* Moves bytes in and out once an interrupt has come in. */
+static struct softirq_work serial_work;
+
 static void set_serial (int bps);
 static void putc_poll (uint8_t);
 static void write_ier (void);
 static intr_handler_func serial_interrupt;
+static softirq_func serial_softirq;
 
 /* Initializes the serial port device for polling mode.
    Polling mode busy-waits for the serial port to become free
@@ -85,6 +90,7 @@ serial_init_queue (void) {
 		init_poll ();
 	ASSERT (mode == POLL);
 
+	softirq_work_init (&serial_work, serial_softirq, NULL);
 	intr_register_ext (0x20 + 4, serial_interrupt, "serial");
 	mode = QUEUE;
 	old_level = intr_disable ();
@@ -200,16 +206,39 @@ serial_interrupt (struct intr_frame *f UNUSED) {
 	   occasionally miss an interrupt running under QEMU. */
 	inb (IIR_REG);
 
-	/* As long as we have room to receive a byte, and the hardware
-	   has a byte for us, receive a byte.  */
-	while (!input_full () && (inb (LSR_REG) & LSR_DR) != 0)
-		input_putc (inb (RBR_REG));
+	/* Keep the UART quiet until serial_softirq() has moved the
+	   data; it turns the interrupts it needs back on. */
+	outb (IER_REG, 0);
+	softirq_queue (&serial_work, SOFTIRQ_LO);
+}
 
-	/* As long as we have a byte to transmit, and the hardware is
-	   ready to accept a byte for transmission, transmit a byte. */
-	while (!intq_empty (&txq) && (inb (LSR_REG) & LSR_THRE) != 0)
-		outb (THR_REG, intq_getc (&txq));
+/* Deferred part of the serial interrupt.  Interrupts are only off
+   while one byte is moved. */
+static void
+serial_softirq (void *aux UNUSED) {
+	bool progress;
+
+	do {
+		enum intr_level old_level = intr_disable ();
+		progress = false;
+
+		/* If we have room to receive a byte, and the hardware has a
+		   byte for us, receive a byte. */
+		if (!input_full () && (inb (LSR_REG) & LSR_DR) != 0) {
+			input_putc (inb (RBR_REG));
+			progress = true;
+		}
 
-	/* Update interrupt enable register based on queue status. */
-	write_ier ();
+		/* If we have a byte to transmit, and the hardware is ready
+		   to accept a byte for transmission, transmit a byte. */
+		if (!intq_empty (&txq) && (inb (LSR_REG) & LSR_THRE) != 0) {
+			outb (THR_REG, intq_getc (&txq));
+			progress = true;
+		}
+
+		/* Update interrupt enable register based on queue status. */
+		if (!progress)
+			write_ier ();
+		intr_set_level (old_level);
+	} while (progress);
 }
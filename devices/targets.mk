@@ -1,4 +1,7 @@
 devices_SRC  = devices/timer.c		# Timer device.
+devices_SRC += devices/hrtimer.c	# High-resolution timers.
+devices_SRC += devices/lapic.c		# Local APIC.
+devices_SRC += devices/ioapic.c		# I/O APIC.
 devices_SRC += devices/kbd.c		# Keyboard device.
 devices_SRC += devices/vga.c		# Video device.
 devices_SRC += devices/serial.c		# Serial port device.
@@ -3,10 +3,16 @@
 #include <inttypes.h>
 #include <round.h>
 #include <stdio.h>
+#include <string.h>
+#include "devices/hrtimer.h"
 #include "threads/interrupt.h"
 #include "threads/io.h"
+#include "threads/palloc.h"
+#include "threads/softirq.h"
 #include "threads/synch.h"
 #include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "intrinsic.h"
 
 /* See [8254] for hardware details of the 8254 timer chip. */
 //타이머의 주파수가 적절한 범위인지 확인하고, 조건에 맞지 않으면 에러 발생
@@ -18,23 +24,89 @@
 #endif
 
 
-/* 시스템이 부팅된 이후 지나간 타이머 틱 수. Number of timer ticks since OS booted. */
+/* 시스템이 부팅된 이후 지나간 타이머 틱 수. Number of timer ticks since OS booted.
+   Only changed with interrupts off, through ticks_add(), which
+   makes TICKS_SEQ odd while it writes so that timer_ticks() can
+   read a consistent value without turning interrupts off. */
 static int64_t ticks;
+static volatile unsigned ticks_seq;
 
 
 #define F (1 << 14) /* fixed point 1 */
 
-int64_t MIN_alarm_time = INT64_MAX;
+/* Sleeping threads, kept as a binary min-heap keyed on `wakeup'
+   (ties broken by higher priority first), so the timer interrupt
+   only has to look at sleep_heap[0] to know whether anyone is due.
+   The array lives in palloc'd pages and doubles when full. */
+static struct thread **sleep_heap;
+static size_t sleep_cnt;        /* # of threads in sleep_heap. */
+static size_t sleep_cap;        /* # of slots in sleep_heap. */
+
+/* If true, stop the periodic tick while only the idle thread is
+   runnable.  Controlled by kernel command-line option "-tickless". */
+bool timer_tickless;
+
+/* 8254 input frequency divided by TIMER_FREQ, rounded to nearest:
+   the number of PIT counts in one timer tick. */
+#define PIT_TICK_COUNT ((1193180 + TIMER_FREQ / 2) / TIMER_FREQ)
+
+/* One-shot state for tickless idle.  While ONESHOT_TICKS is
+   nonzero the PIT is in mode 0 and will interrupt once, ONESHOT_TICKS
+   tick boundaries after the last periodic tick. */
+static int64_t oneshot_ticks;   /* Ticks covered by the armed one-shot. */
+static unsigned oneshot_count;  /* Count the one-shot was loaded with. */
+static unsigned oneshot_partial;/* Counts of the current tick already gone when armed. */
+
+/* Timer work that does not have to run with interrupts off:
+   waking sleepers and the MLFQS recalculations.  TICKS_DONE is the
+   last tick it has caught up with. */
+static struct softirq_work timer_work;
+static int64_t ticks_done;
 
 /* Number of loops per timer tick.
    Initialized by timer_calibrate().
    타이머 틱마다 수행할 수프 횟수 */
 static unsigned loops_per_tick;
 
+/* If nonzero, timer_calibrate() takes this as loops_per_tick
+   instead of measuring it.  Set by kernel command-line option
+   "-loops-per-tick=N", typically with the value an earlier boot
+   printed. */
+unsigned timer_loops_per_tick;
+
+/* Time-stamp counter frequency, in Hz.  Set by timer_calibrate(),
+   from CPUID if the CPU reports it, otherwise measured against
+   PIT counter 2 over PIT_CALIBRATE_MS, or, if that fails, over
+   TSC_CALIBRATE_TICKS timer ticks. */
+#define PIT_CALIBRATE_MS 10
+#define PIT_CALIBRATE_SPINS 10000000
+#define TSC_CALIBRATE_TICKS 2
+static uint64_t tsc_hz;
+
+/* TSC to nanosecond scaling: ns = (cycles * TSC_MULT) >> TSC_SHIFT.
+   TSC_BOOT is the TSC value that timer_ns() counts from. */
+#define TSC_SHIFT 32
+static uint64_t tsc_mult;
+static uint64_t tsc_boot;
+
 static intr_handler_func timer_interrupt;//타이머 인터럽트를 처리할 함수의 포인터 정의
+static softirq_func timer_softirq;
 static bool too_many_loops (unsigned loops);//지정된 루프 수가 한틱이상 걸리는지
 static void busy_wait (int64_t loops);//바쁜 대기 함수 선언. 주어진 횟수만큼 루프를 돈다
 static void real_time_sleep (int64_t num, int32_t denom);//실제시간 기반 대기함수. 실시간으로 계산된 시간 동안 대기하는 함수의 프로토 타입
+static bool tsc_calibrate_cpuid (void);
+static bool tsc_calibrate_pit (void);
+static void tsc_calibrate_ticks (void);
+static void tsc_set_hz (uint64_t hz);
+static void loops_calibrate_tsc (void);
+static void loops_calibrate_ticks (void);
+static void ticks_add (int64_t);
+static bool sleep_before (const struct thread *, const struct thread *);
+static void sleep_heap_push (struct thread *);
+static struct thread *sleep_heap_pop (void);
+static void sleep_heap_grow (void);
+static void pit_program (uint8_t mode, uint16_t count);
+static uint16_t pit_read (void);
 
 
 /* Sets up the 8254 Programmable Interval Timer (PIT) to
@@ -49,49 +121,122 @@ void timer_init (void) {//타이머 장치 초기화
 	/* 8254 input frequency divided by TIMER_FREQ, rounded to
 	   nearest.
 	   8254타이머 칩의 입력 주파수를 TIMER+FREQ로, 나누고 반올림한다. */
-	uint16_t count = (1193180 + TIMER_FREQ / 2) / TIMER_FREQ;
-					//1193180은 8254타이머 칩의 입력 기본 주파수이다
-	outb (0x43, 0x34);    /* CW: counter 0, LSB then MSB, mode 2, binary. */
-	outb (0x40, count & 0xff);
-	outb (0x40, count >> 8);
+	pit_program (2, PIT_TICK_COUNT);  //1193180은 8254타이머 칩의 입력 기본 주파수이다
+	tsc_boot = rdtsc ();
 
+	sleep_heap = palloc_get_page (PAL_ASSERT);
+	sleep_cap = PGSIZE / sizeof *sleep_heap;
+	sleep_cnt = 0;
+
+	softirq_work_init (&timer_work, timer_softirq, NULL);
 	intr_register_ext (0x20, timer_interrupt, "8254 Timer");
 }
 
-/* Calibrates loops_per_tick, used to implement brief delays. */
+/* Calibrates the TSC and loops_per_tick, used to implement brief
+   delays.
+
+   The fast path takes the TSC frequency from CPUID or from one
+   10 ms shot of PIT counter 2, then times a busy_wait() against
+   the TSC, so no timer tick edges have to be waited for.  Only if
+   counter 2 does not respond does this fall back to counting
+   loops against timer ticks, which takes about a dozen ticks. */
 void
 timer_calibrate (void) {
-	unsigned high_bit, test_bit;
+	uint64_t start = rdtsc ();
+	const char *how;
 
 	ASSERT (intr_get_level () == INTR_ON);
 	printf ("Calibrating timer...  ");
 
-	/* Approximate loops_per_tick as the largest power-of-two
-	   still less than one timer tick. */
-	loops_per_tick = 1u << 10;
-	while (!too_many_loops (loops_per_tick << 1)) {
-		loops_per_tick <<= 1;
-		ASSERT (loops_per_tick != 0);
+	if (tsc_calibrate_cpuid ())
+		how = "cpuid";
+	else if (tsc_calibrate_pit ())
+		how = "pit";
+	else
+		how = NULL;
+
+	if (timer_loops_per_tick != 0) {
+		loops_per_tick = timer_loops_per_tick;
+		how = "cached";
+	} else if (how != NULL)
+		loops_calibrate_tsc ();
+	else
+		loops_calibrate_ticks ();
+
+	if (tsc_hz == 0) {
+		tsc_calibrate_ticks ();
+		if (how == NULL)
+			how = "ticks";
 	}
 
-	/* Refine the next 8 bits of loops_per_tick. */
-	high_bit = loops_per_tick;
-	for (test_bit = high_bit >> 1; test_bit != high_bit >> 10; test_bit >>= 1)
-		if (!too_many_loops (high_bit | test_bit))
-			loops_per_tick |= test_bit;
+	printf ("%'"PRIu64" loops/s (-loops-per-tick=%u, %s, %'"PRId64" us).\n",
+			(uint64_t) loops_per_tick * TIMER_FREQ, loops_per_tick, how,
+			timer_tsc_to_ns (rdtsc () - start) / 1000);
+}
+
+/* Returns the TSC frequency in Hz, or 0 before timer_calibrate(). */
+uint64_t
+timer_tsc_hz (void) {
+	return tsc_hz;
+}
+
+/* Converts a count of TSC cycles to nanoseconds.  The product
+   is taken in 128 bits, which the CPU does in one instruction. */
+int64_t
+timer_tsc_to_ns (uint64_t tsc) {
+	ASSERT (tsc_mult != 0);
+	return ((unsigned __int128) tsc * tsc_mult) >> TSC_SHIFT;
+}
+
+/* Returns the number of nanoseconds since timer_init(), read from
+   the TSC without touching the interrupt flag.  Until
+   timer_calibrate() has run it only advances once per tick. */
+int64_t
+timer_ns (void) {
+	if (tsc_mult == 0)
+		return timer_ticks () * (1000000000 / TIMER_FREQ);
+	return timer_tsc_to_ns (rdtsc () - tsc_boot);
+}
 
-	printf ("%'"PRIu64" loops/s.\n", (uint64_t) loops_per_tick * TIMER_FREQ);
+/* Converts NS nanoseconds, which must not be negative, to TSC
+   cycles. */
+uint64_t
+timer_ns_to_tsc (int64_t ns) {
+	ASSERT (tsc_hz != 0);
+	ASSERT (ns >= 0);
+	return (ns / 1000000000) * tsc_hz
+		+ (ns % 1000000000) * tsc_hz / 1000000000;
 }
 
-/* Returns the number of timer ticks since the OS booted. */
+/* Returns the number of timer ticks since the OS booted.
+   Lock-free: retries if the timer interrupt updated TICKS in the
+   middle of the read. */
 int64_t
 timer_ticks (void) {
-	enum intr_level old_level = intr_disable ();
-	int64_t t = ticks;
-	intr_set_level (old_level);
-	barrier ();
+	unsigned seq;
+	int64_t t;
+
+	do {
+		seq = ticks_seq;
+		barrier ();
+		t = ticks;
+		barrier ();
+	} while ((seq & 1) != 0 || seq != ticks_seq);
 	return t;
 }
+
+/* Advances TICKS by N, as seen by timer_ticks().  Interrupts
+   must be off. */
+static void
+ticks_add (int64_t n) {
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	ticks_seq++;
+	barrier ();
+	ticks += n;
+	barrier ();
+	ticks_seq++;
+}
 // 잠든 스레드가 깰 시간(ticks)에 도달할 때까지 ready_list에 추가X,
 //깰 시간(ticks)에 도달한 경우에만 ready_list에 추가
 
@@ -119,9 +264,9 @@ timer_sleep (int64_t ticks) {
 		//thread_yield ();
 }
 
-//잠든 스레드를 sleep_list에 삽입
+//잠든 스레드를 sleep_heap에 삽입
 //스레드 구조체가 깨어날 시각인 ticks를 저장
-//sleep_list에 ticks가 작은 스레드가 앞에 오도록 정렬 삽입
+//heap은 wakeup이 가장 작은(같으면 우선순위가 높은) 스레드가 루트에 오도록 유지
 //현재 thread는 잠들어야 하니 thread_block()
 void thread_sleep(int64_t ticks) {
 	struct thread *curr = thread_current ();//현재 실행중인 스레드
@@ -130,26 +275,190 @@ void thread_sleep(int64_t ticks) {
 	ASSERT (!intr_context ());//외부 인터럽트가 들어왔으면 True, 아니면 False
 
 	old_level = intr_disable (); //두꺼비집 끄기
-	
+	while (sleep_cnt == sleep_cap) {
+		/* palloc may sleep on its pool lock, so grow with
+		   interrupts restored and re-check afterwards. */
+		intr_set_level (old_level);
+		sleep_heap_grow ();
+		intr_disable ();
+	}
+
 	curr->wakeup = ticks;
-	list_push_back (&sleep_list, &curr->elem);//ready리스트 맨 마지막에 curr
-	//do_schedule (THREAD_READY);//컨텍스트 스위칭,  running->ready
+	sleep_heap_push (curr);
 	thread_block();
 	intr_set_level (old_level); //두꺼비집 키기
 }
 
+/* Wakes every thread whose wakeup tick is at or before WAKEUP.
+   Costs O(1) when nobody is due and O(k log n) when K threads
+   wake.  Threads due on the same tick come off the heap in
+   priority order.  Interrupts are only turned off for one
+   thread at a time, so waking many sleepers at once does not
+   hold off interrupts for long. */
 void thread_awake(int64_t wakeup) {
-	struct list_elem *e = list_begin(&sleep_list);
-	while (e != list_end(&sleep_list) ) {
-		struct thread *t = list_entry(e, struct thread, elem);
-		if (t->wakeup <= ticks) {//
-		e = list_remove(e);
-		thread_unblock(t);
-		} else {
-			e = list_next(e);
-		}
+	bool woke = false;
+
+	for (;;) {
+		enum intr_level old_level = intr_disable ();
+		bool due = sleep_cnt > 0 && sleep_heap[0]->wakeup <= wakeup;
+		if (due)
+			thread_unblock (sleep_heap_pop ());
+		intr_set_level (old_level);
+		if (!due)
+			break;
+		woke = true;
 	}
+	if (woke)
+		check_preemption ();
+}
 
+/* Called by the idle thread, with interrupts off, right before it
+   halts.  In tickless mode, reprograms the PIT to interrupt once at
+   the earliest sleeper's deadline instead of on every tick.  The
+   8254 counter is only 16 bits, so one shot covers at most
+   0xffff / PIT_TICK_COUNT ticks (5 at the default TIMER_FREQ).
+   Under MLFQS the shot also stops at the next multiple of 4 ticks
+   so that the periodic recalculations in timer_interrupt() still
+   run on schedule. */
+void
+timer_idle_enter (void) {
+	int64_t shot = 0xffff / PIT_TICK_COUNT;
+	unsigned partial;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (!timer_tickless || oneshot_ticks != 0 || hrtimer_needs_tick ())
+		return;
+
+	if (sleep_cnt > 0 && sleep_heap[0]->wakeup - ticks < shot)
+		shot = sleep_heap[0]->wakeup - ticks;
+	if (thread_mlfqs && 4 - ticks % 4 < shot)
+		shot = 4 - ticks % 4;
+	if (shot < 2)
+		return;
+
+	/* Line the shot up with the tick boundaries we would have had:
+	   subtract what has already elapsed of the current period. */
+	partial = PIT_TICK_COUNT - pit_read ();
+	oneshot_ticks = shot;
+	oneshot_partial = partial;
+	oneshot_count = shot * PIT_TICK_COUNT - partial;
+	pit_program (0, oneshot_count);
+}
+
+/* Called when the CPU stops being idle, with interrupts off.  If a
+   one-shot is still pending, credits the whole ticks that have
+   elapsed and arms one more shot for the rest of the current
+   tick; its interrupt puts the PIT back into periodic mode.  If
+   the shot already fired, its interrupt is pending and will do the
+   accounting itself. */
+void
+timer_idle_exit (void) {
+	unsigned remaining, elapsed;
+	int64_t whole;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (oneshot_ticks == 0)
+		return;
+
+	remaining = pit_read ();
+	if (remaining == 0 || remaining > oneshot_count) {
+		/* Terminal count reached; the counter has wrapped. */
+		whole = oneshot_ticks - 1;
+		ticks_add (whole);
+		thread_tick_idle (whole);
+		oneshot_ticks = 0;
+		pit_program (2, PIT_TICK_COUNT);
+		return;
+	}
+
+	elapsed = oneshot_partial + (oneshot_count - remaining);
+	whole = elapsed / PIT_TICK_COUNT;
+	ticks_add (whole);
+	thread_tick_idle (whole);
+
+	oneshot_ticks = 1;
+	oneshot_partial = 0;
+	oneshot_count = PIT_TICK_COUNT - elapsed % PIT_TICK_COUNT;
+	pit_program (0, oneshot_count);
+}
+
+/* Returns true if A should wake before B. */
+static bool
+sleep_before (const struct thread *a, const struct thread *b) {
+	if (a->wakeup != b->wakeup)
+		return a->wakeup < b->wakeup;
+	return a->priority > b->priority;
+}
+
+/* Adds T to the sleep heap.  There must be a free slot. */
+static void
+sleep_heap_push (struct thread *t) {
+	size_t i;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+	ASSERT (sleep_cnt < sleep_cap);
+
+	/* Sift up. */
+	for (i = sleep_cnt++; i > 0; ) {
+		size_t parent = (i - 1) / 2;
+		if (!sleep_before (t, sleep_heap[parent]))
+			break;
+		sleep_heap[i] = sleep_heap[parent];
+		i = parent;
+	}
+	sleep_heap[i] = t;
+}
+
+/* Removes and returns the root of the sleep heap, which must not
+   be empty. */
+static struct thread *
+sleep_heap_pop (void) {
+	struct thread *top, *last;
+	size_t i, child;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+	ASSERT (sleep_cnt > 0);
+
+	top = sleep_heap[0];
+	last = sleep_heap[--sleep_cnt];
+
+	/* Sift LAST down from the root. */
+	for (i = 0; (child = 2 * i + 1) < sleep_cnt; i = child) {
+		if (child + 1 < sleep_cnt
+				&& sleep_before (sleep_heap[child + 1], sleep_heap[child]))
+			child++;
+		if (!sleep_before (sleep_heap[child], last))
+			break;
+		sleep_heap[i] = sleep_heap[child];
+	}
+	sleep_heap[i] = last;
+	return top;
+}
+
+/* Doubles the capacity of the sleep heap.  Must be called with
+   interrupts on, since the page allocator may sleep. */
+static void
+sleep_heap_grow (void) {
+	size_t old_pages = sleep_cap * sizeof *sleep_heap / PGSIZE;
+	size_t new_pages = old_pages * 2;
+	struct thread **new_heap = palloc_get_multiple (PAL_ASSERT, new_pages);
+	struct thread **unused = new_heap;
+	size_t unused_pages = new_pages;
+	enum intr_level old_level;
+
+	old_level = intr_disable ();
+	if (new_pages * PGSIZE / sizeof *sleep_heap > sleep_cap) {
+		memcpy (new_heap, sleep_heap, sleep_cnt * sizeof *sleep_heap);
+		unused = sleep_heap;
+		unused_pages = sleep_cap * sizeof *sleep_heap / PGSIZE;
+		sleep_heap = new_heap;
+		sleep_cap = new_pages * PGSIZE / sizeof *sleep_heap;
+	}
+	intr_set_level (old_level);
+
+	palloc_free_multiple (unused, unused_pages);
 }
 
 //  * struct list_elem *e;
@@ -192,31 +501,78 @@ timer_print_stats (void) {
 /* Timer interrupt handler. */
 static void
 timer_interrupt (struct intr_frame *args UNUSED) {
-	ticks++;
+	if (oneshot_ticks != 0) {
+		/* A tickless one-shot expired: the ticks it skipped went
+		   by idle.  Go back to periodic mode. */
+		ticks_add (oneshot_ticks - 1);
+		thread_tick_idle (oneshot_ticks - 1);
+		oneshot_ticks = 0;
+		pit_program (2, PIT_TICK_COUNT);
+	}
+	ticks_add (1);
 	thread_tick ();
-	//thread_awake(ticks);//ticks가 증가할때마다 수행
-	//mlfqs 스케줄러일 경우
-	//timer_interrupt가 발생할때마다 recent_cpu 1증가,
-	//1초마다 load_avg, recent_cpu, priority 계산,
-	//매 4tcik 마다 priority 계산
+	/* These charge the interrupted thread, so they cannot be left
+	   to softirqd, which would be the running thread by then. */
 	if (thread_mlfqs) {
 		mlfqs_increment();
-
-		if (timer_ticks() % 4 == 0)  {
+		if (ticks % 4 == 0)
 			mlfqs_recalc_priority();
-		}
+	}
+	hrtimer_tick ();
+
+	/* The rest can wait until the PIC has been acknowledged. */
+	softirq_queue (&timer_work, SOFTIRQ_HI);
+}
 
-		if (timer_ticks() % 100 == 0) {
-			mlfqs_load_avg();
-				//mlfqs_recalc_priority();
-			mlfqs_recalc_recent_cpu();
+/* Deferred part of the timer interrupt, run with interrupts on.
+   Catches up with every tick since the last run, in case some
+   were skipped (tickless idle) or this run was delayed. */
+static void
+timer_softirq (void *aux UNUSED) {
+	int64_t now = timer_ticks ();
+
+	//mlfqs 스케줄러일 경우
+	//1초마다 load_avg 계산, 실행중/ready 스레드의 recent_cpu, priority 계산
+	//blocked 스레드는 깨어날 때 밀린 decay를 한꺼번에 적용
+	/* This may run in softirqd, which is then the running thread.
+	   The MLFQS functions leave softirqd out (see mlfqs_exempt()),
+	   so the interrupted thread, waiting in the run queue, is
+	   counted and decayed like any other ready thread.  The
+	   per-tick work, which charges only the interrupted thread,
+	   stays in timer_interrupt(). */
+	if (thread_mlfqs) {
+		enum intr_level old_level = intr_disable ();
+
+		while (ticks_done < now)
+			if (++ticks_done % TIMER_FREQ == 0) {
+				mlfqs_load_avg();
+				mlfqs_recalc_recent_cpu();
 			}
-		}
-		//if(MIN_alarm_time <= ticks) {
-			thread_awake(ticks);
-		//}
-	
+		intr_set_level (old_level);
+	}
+	ticks_done = now;
+
+	thread_awake(now);
+}
 
+/* Programs counter 0 of the 8254 in MODE (2: rate generator,
+   0: interrupt on terminal count) with initial COUNT. */
+static void
+pit_program (uint8_t mode, uint16_t count) {
+	outb (0x43, 0x30 | (mode << 1)); /* CW: counter 0, LSB then MSB, MODE, binary. */
+	outb (0x40, count & 0xff);
+	outb (0x40, count >> 8);
+}
+
+/* Latches and returns the current value of counter 0. */
+static uint16_t
+pit_read (void) {
+	uint8_t lo, hi;
+
+	outb (0x43, 0x00);    /* Counter latch command for counter 0. */
+	lo = inb (0x40);
+	hi = inb (0x40);
+	return lo | (hi << 8);
 }
 
 /* Returns true if LOOPS iterations waits for more than one timer
@@ -237,6 +593,141 @@ too_many_loops (unsigned loops) {
 	return start != ticks;
 }
 
+/* Takes the TSC frequency from CPUID leaf 0x15, which gives it
+   as a ratio to the core crystal clock, with the crystal's
+   frequency from leaf 0x16's base frequency if leaf 0x15 leaves
+   it out.  Returns false if the CPU does not say. */
+static bool
+tsc_calibrate_cpuid (void) {
+	uint32_t r[4];
+	uint64_t crystal_hz;
+	uint32_t max, denom, numer;
+
+	cpuid (0, r);
+	max = r[0];
+	if (max < 0x15)
+		return false;
+
+	cpuid (0x15, r);
+	denom = r[0];
+	numer = r[1];
+	crystal_hz = r[2];
+	if (denom == 0 || numer == 0)
+		return false;
+	if (crystal_hz == 0) {
+		if (max < 0x16)
+			return false;
+		cpuid (0x16, r);
+		crystal_hz = (uint64_t) (r[0] & 0xffff) * 1000000 * denom / numer;
+		if (crystal_hz == 0)
+			return false;
+	}
+	tsc_set_hz (crystal_hz * numer / denom);
+	return true;
+}
+
+/* Measures the TSC over one PIT_CALIBRATE_MS shot of PIT counter
+   2, the one normally wired to the PC speaker: its output can be
+   polled through port 0x61 without any interrupts.  Returns false
+   if the counter never finishes. */
+static bool
+tsc_calibrate_pit (void) {
+	uint16_t count = 1193180 * PIT_CALIBRATE_MS / 1000;
+	uint8_t port61 = inb (0x61);
+	uint64_t start, end;
+	long spins = 0;
+
+	outb (0x61, (port61 & ~0x02) | 0x01);   /* Gate counter 2 on, speaker off. */
+	outb (0x43, 0xb0);                      /* CW: counter 2, LSB then MSB, mode 0, binary. */
+	outb (0x42, count & 0xff);
+	outb (0x42, count >> 8);
+	start = rdtsc ();
+	while ((inb (0x61) & 0x20) == 0)        /* Wait for OUT2 to go high. */
+		if (++spins > PIT_CALIBRATE_SPINS) {
+			outb (0x61, port61);
+			return false;
+		}
+	end = rdtsc ();
+	outb (0x61, port61);
+
+	if (end <= start)
+		return false;
+	tsc_set_hz ((end - start) * 1000 / PIT_CALIBRATE_MS);
+	return true;
+}
+
+/* Measures the TSC over TSC_CALIBRATE_TICKS timer ticks, starting
+   right on a tick. */
+static void
+tsc_calibrate_ticks (void) {
+	int64_t start = ticks;
+	uint64_t tsc;
+
+	ASSERT (intr_get_level () == INTR_ON);
+
+	while (ticks == start)
+		barrier ();
+	tsc = rdtsc ();
+	start = ticks;
+	while (ticks - start < TSC_CALIBRATE_TICKS)
+		barrier ();
+	tsc_set_hz ((rdtsc () - tsc) * TIMER_FREQ / TSC_CALIBRATE_TICKS);
+}
+
+/* Sets the TSC frequency to HZ. */
+static void
+tsc_set_hz (uint64_t hz) {
+	ASSERT (hz != 0);
+
+	tsc_hz = hz;
+	tsc_mult = (1000000000ULL << TSC_SHIFT) / tsc_hz;
+}
+
+/* Sets loops_per_tick by timing busy_wait() against the TSC.  The
+   fastest of a few runs is taken, since an interrupt can only make
+   a run slower. */
+static void
+loops_calibrate_tsc (void) {
+	const int64_t loops = 1 << 18;
+	uint64_t best = UINT64_MAX;
+
+	for (int i = 0; i < 3; i++) {
+		uint64_t start = rdtsc ();
+		uint64_t cycles;
+
+		busy_wait (loops);
+		cycles = rdtsc () - start;
+		if (cycles < best)
+			best = cycles;
+	}
+	if (best == 0)
+		best = 1;
+	loops_per_tick = loops * (tsc_hz / TIMER_FREQ) / best;
+	if (loops_per_tick == 0)
+		loops_per_tick = 1;
+}
+
+/* Sets loops_per_tick by counting how many busy_wait() loops fit
+   in one timer tick.  Slow: every probe waits for a tick edge. */
+static void
+loops_calibrate_ticks (void) {
+	unsigned high_bit, test_bit;
+
+	/* Approximate loops_per_tick as the largest power-of-two
+	   still less than one timer tick. */
+	loops_per_tick = 1u << 10;
+	while (!too_many_loops (loops_per_tick << 1)) {
+		loops_per_tick <<= 1;
+		ASSERT (loops_per_tick != 0);
+	}
+
+	/* Refine the next 8 bits of loops_per_tick. */
+	high_bit = loops_per_tick;
+	for (test_bit = high_bit >> 1; test_bit != high_bit >> 10; test_bit >>= 1)
+		if (!too_many_loops (high_bit | test_bit))
+			loops_per_tick |= test_bit;
+}
+
 /* Iterates through a simple loop LOOPS times, for implementing
    brief delays.
 
@@ -268,10 +759,13 @@ real_time_sleep (int64_t num, int32_t denom) {
 		   processes. */
 		timer_sleep (ticks);
 	} else {
-		/* Otherwise, use a busy-wait loop for more accurate
-		   sub-tick timing.  We scale the numerator and denominator
-		   down by 1000 to avoid the possibility of overflow. */
+		/* Otherwise, block on a high-resolution timer for more
+		   accurate sub-tick timing.  Before those are up, fall back
+		   to a busy-wait loop; we scale the numerator and
+		   denominator down by 1000 to avoid the possibility of
+		   overflow. */
 		ASSERT (denom % 1000 == 0);
-		busy_wait (loops_per_tick * num / 1000 * TIMER_FREQ / (denom / 1000));
+		if (!hrtimer_sleep (num * (1000000000 / denom)))
+			busy_wait (loops_per_tick * num / 1000 * TIMER_FREQ / (denom / 1000));
 	}
 }
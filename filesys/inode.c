@@ -5,7 +5,10 @@
 #include <string.h>
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
+#include "filesys/text-cache.h"
+#include "threads/interrupt.h"
 #include "threads/malloc.h"
+#include "threads/synch.h"
 
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
@@ -33,6 +36,7 @@ struct inode {
 	int open_cnt;                       /* Number of openers. */
 	bool removed;                       /* True if deleted, false otherwise. */
 	int deny_write_cnt;                 /* 0: writes ok, >0: deny writes. */
+	struct rwlock rwlock;               /* Guards contents, for callers. */
 	struct inode_disk data;             /* Inode content. */
 };
 
@@ -50,13 +54,21 @@ byte_to_sector (const struct inode *inode, off_t pos) {
 }
 
 /* List of open inodes, so that opening a single inode twice
- * returns the same `struct inode'. */
+ * returns the same `struct inode'.  Lookups share
+ * open_inodes_lock; adding or removing an inode takes it
+ * exclusively.  open_cnt itself is only changed with interrupts
+ * off, so concurrent lookups may bump it safely. */
 static struct list open_inodes;
+static struct rwlock open_inodes_lock;
+
+static struct inode *find_open_inode (disk_sector_t);
 
 /* Initializes the inode module. */
 void
 inode_init (void) {
 	list_init (&open_inodes);
+	rwlock_init (&open_inodes_lock);
+	text_cache_init ();
 }
 
 /* Initializes an inode with LENGTH bytes of data and
@@ -101,18 +113,15 @@ inode_create (disk_sector_t sector, off_t length) {
  * Returns a null pointer if memory allocation fails. */
 struct inode *
 inode_open (disk_sector_t sector) {
-	struct list_elem *e;
 	struct inode *inode;
 
-	/* Check whether this inode is already open. */
-	for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
-			e = list_next (e)) {
-		inode = list_entry (e, struct inode, elem);
-		if (inode->sector == sector) {
-			inode_reopen (inode);
-			return inode; 
-		}
-	}
+	/* Check whether this inode is already open.  Concurrent opens
+	 * only share the lock. */
+	rwlock_acquire_read (&open_inodes_lock);
+	inode = inode_reopen (find_open_inode (sector));
+	rwlock_release_read (&open_inodes_lock);
+	if (inode != NULL)
+		return inode;
 
 	/* Allocate memory. */
 	inode = malloc (sizeof *inode);
@@ -120,23 +129,60 @@ inode_open (disk_sector_t sector) {
 		return NULL;
 
 	/* Initialize. */
-	list_push_front (&open_inodes, &inode->elem);
 	inode->sector = sector;
 	inode->open_cnt = 1;
 	inode->deny_write_cnt = 0;
 	inode->removed = false;
+	rwlock_init (&inode->rwlock);
 	disk_read (filesys_disk, inode->sector, &inode->data);
+
+	/* Someone else may have opened it while we were reading. */
+	rwlock_acquire_write (&open_inodes_lock);
+	struct inode *other = inode_reopen (find_open_inode (sector));
+	if (other == NULL)
+		list_push_front (&open_inodes, &inode->elem);
+	rwlock_release_write (&open_inodes_lock);
+	if (other != NULL) {
+		free (inode);
+		inode = other;
+	}
 	return inode;
 }
 
+/* Returns the open inode for SECTOR, or a null pointer if there
+ * is none.  open_inodes_lock must be held. */
+static struct inode *
+find_open_inode (disk_sector_t sector) {
+	struct list_elem *e;
+
+	for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
+			e = list_next (e)) {
+		struct inode *inode = list_entry (e, struct inode, elem);
+		if (inode->sector == sector)
+			return inode;
+	}
+	return NULL;
+}
+
 /* Reopens and returns INODE. */
 struct inode *
 inode_reopen (struct inode *inode) {
-	if (inode != NULL)
+	if (inode != NULL) {
+		enum intr_level old_level = intr_disable ();
 		inode->open_cnt++;
+		intr_set_level (old_level);
+	}
 	return inode;
 }
 
+/* Returns the reader-writer lock that callers such as the
+ * directory code use to guard INODE's contents.  The inode layer
+ * itself does not take it. */
+struct rwlock *
+inode_rwlock (struct inode *inode) {
+	return &inode->rwlock;
+}
+
 /* Returns INODE's inode number. */
 disk_sector_t
 inode_get_inumber (const struct inode *inode) {
@@ -153,12 +199,18 @@ inode_close (struct inode *inode) {
 		return;
 
 	/* Release resources if this was the last opener. */
-	if (--inode->open_cnt == 0) {
-		/* Remove from inode list and release lock. */
+	rwlock_acquire_write (&open_inodes_lock);
+	enum intr_level old_level = intr_disable ();
+	bool last = --inode->open_cnt == 0;
+	intr_set_level (old_level);
+	if (last)
 		list_remove (&inode->elem);
+	rwlock_release_write (&open_inodes_lock);
 
+	if (last) {
 		/* Deallocate blocks if removed. */
 		if (inode->removed) {
+			text_cache_invalidate (inode, 0, inode->data.length);
 			free_map_release (inode->sector, 1);
 			free_map_release (inode->data.start,
 					bytes_to_sectors (inode->data.length)); 
@@ -239,6 +291,7 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
 
 	if (inode->deny_write_cnt)
 		return 0;
+	text_cache_invalidate (inode, offset, size);
 
 	while (size > 0) {
 		/* Sector to write, starting byte offset within sector. */
@@ -0,0 +1,197 @@
+/* Text cache.
+
+   Frames holding whole pages of executables, keyed by inode
+   number and page-aligned file offset, so that every process
+   running the same program maps the same frames for its code and
+   read-only data instead of reading a copy of its own.  The cache
+   holds one palloc reference to each frame and each mapping
+   another, so a frame outlives its cache entry for as long as it
+   is mapped.  Entries outlive the processes, so a program run
+   again finds its pages still here.
+
+   Writes to an executable are denied while it runs, but not once
+   it has exited, so inode_write_at() drops the pages a write
+   covers, and inode_close() those of a removed file, whose
+   sectors may be reused.
+
+   The cache's TEXT_CACHE_MAX frames can be much of the user pool,
+   so a user page allocation for a program's pages that fails
+   first frees cached frames that no process maps, with
+   text_cache_shrink(), and tries again. */
+
+#include "filesys/text-cache.h"
+#include <debug.h>
+#include <hash.h>
+#include <list.h>
+#include "filesys/inode.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Number of hash buckets.  Must be a power of 2. */
+#define TEXT_CACHE_BUCKETS 64
+
+/* Most pages kept.  The least recently looked up go first. */
+#define TEXT_CACHE_MAX 512
+
+/* A cached page. */
+struct text_page {
+	struct list_elem hash_elem;         /* Element in its bucket. */
+	struct list_elem lru_elem;          /* Element in lru. */
+	disk_sector_t inumber;              /* Inode. */
+	off_t ofs;                          /* Page-aligned offset in it. */
+	void *kpage;                        /* Frame, from the user pool. */
+};
+
+static struct lock text_cache_lock;
+static struct list buckets[TEXT_CACHE_BUCKETS];
+static struct list lru;                 /* Most recently used first. */
+static size_t page_cnt;
+
+static struct list *text_bucket (disk_sector_t, off_t);
+static struct text_page *text_find (disk_sector_t, off_t);
+static void text_drop (struct text_page *);
+
+/* Initializes the text cache. */
+void
+text_cache_init (void) {
+	lock_init (&text_cache_lock);
+	for (int i = 0; i < TEXT_CACHE_BUCKETS; i++)
+		list_init (&buckets[i]);
+	list_init (&lru);
+}
+
+/* Returns a frame holding the PGSIZE bytes of INODE at page-aligned
+   offset OFS, reading them in if they are not cached, with a
+   reference for the caller to drop with palloc_free_page().  Its
+   contents must not be changed.  Returns a null pointer if no
+   frame is free or the read comes up short. */
+void *
+text_cache_get (struct inode *inode, off_t ofs) {
+	disk_sector_t inumber = inode_get_inumber (inode);
+	struct text_page *tp;
+	void *kpage;
+
+	ASSERT (ofs % PGSIZE == 0);
+
+	lock_acquire (&text_cache_lock);
+	tp = text_find (inumber, ofs);
+	if (tp != NULL) {
+		list_remove (&tp->lru_elem);
+		list_push_front (&lru, &tp->lru_elem);
+		kpage = tp->kpage;
+		palloc_page_ref (kpage);
+		lock_release (&text_cache_lock);
+		return kpage;
+	}
+	lock_release (&text_cache_lock);
+
+	/* Read without the lock, so that hits need not wait on the
+	   disk. */
+	while ((kpage = palloc_get_page (PAL_USER)) == NULL)
+		if (!text_cache_shrink ())
+			return NULL;
+	if (inode_read_at (inode, kpage, PGSIZE, ofs) != PGSIZE) {
+		palloc_free_page (kpage);
+		return NULL;
+	}
+	tp = malloc (sizeof *tp);
+	if (tp == NULL)
+		return kpage;
+
+	lock_acquire (&text_cache_lock);
+	if (text_find (inumber, ofs) != NULL) {
+		/* Another process read it meanwhile; keep ours private. */
+		lock_release (&text_cache_lock);
+		free (tp);
+		return kpage;
+	}
+	if (page_cnt == TEXT_CACHE_MAX)
+		text_drop (list_entry (list_back (&lru), struct text_page, lru_elem));
+	tp->inumber = inumber;
+	tp->ofs = ofs;
+	tp->kpage = kpage;
+	list_push_back (text_bucket (inumber, ofs), &tp->hash_elem);
+	list_push_front (&lru, &tp->lru_elem);
+	page_cnt++;
+	palloc_page_ref (kpage);
+	lock_release (&text_cache_lock);
+	return kpage;
+}
+
+/* Frees the frame of the least recently looked up page that no
+   process maps, for a user page allocation that failed.  Returns
+   false if every cached page is mapped. */
+bool
+text_cache_shrink (void) {
+	struct list_elem *e;
+	bool freed = false;
+
+	if (page_cnt == 0)
+		return false;
+
+	lock_acquire (&text_cache_lock);
+	for (e = list_rbegin (&lru); e != list_rend (&lru); e = list_prev (e)) {
+		struct text_page *tp = list_entry (e, struct text_page, lru_elem);
+		if (palloc_page_refcnt (tp->kpage) == 1) {
+			text_drop (tp);
+			freed = true;
+			break;
+		}
+	}
+	lock_release (&text_cache_lock);
+	return freed;
+}
+
+/* Drops the cached pages of INODE that overlap the SIZE bytes at
+   offset OFS. */
+void
+text_cache_invalidate (struct inode *inode, off_t ofs, off_t size) {
+	disk_sector_t inumber = inode_get_inumber (inode);
+	off_t page;
+
+	if (page_cnt == 0 || size <= 0)
+		return;
+
+	lock_acquire (&text_cache_lock);
+	for (page = ofs / PGSIZE * PGSIZE; page < ofs + size; page += PGSIZE) {
+		struct text_page *tp = text_find (inumber, page);
+		if (tp != NULL)
+			text_drop (tp);
+	}
+	lock_release (&text_cache_lock);
+}
+
+/* Returns the bucket for page OFS of inode INUMBER. */
+static struct list *
+text_bucket (disk_sector_t inumber, off_t ofs) {
+	uint64_t key = (uint64_t) inumber << 32 | (uint32_t) (ofs / PGSIZE);
+	return &buckets[hash_bytes (&key, sizeof key) & (TEXT_CACHE_BUCKETS - 1)];
+}
+
+/* Returns the cached page OFS of inode INUMBER, or a null pointer.
+   The caller holds text_cache_lock. */
+static struct text_page *
+text_find (disk_sector_t inumber, off_t ofs) {
+	struct list *bucket = text_bucket (inumber, ofs);
+	struct list_elem *e;
+
+	for (e = list_begin (bucket); e != list_end (bucket); e = list_next (e)) {
+		struct text_page *tp = list_entry (e, struct text_page, hash_elem);
+		if (tp->inumber == inumber && tp->ofs == ofs)
+			return tp;
+	}
+	return NULL;
+}
+
+/* Removes TP from the cache and drops the cache's reference to its
+   frame.  The caller holds text_cache_lock. */
+static void
+text_drop (struct text_page *tp) {
+	list_remove (&tp->hash_elem);
+	list_remove (&tp->lru_elem);
+	page_cnt--;
+	palloc_free_page (tp->kpage);
+	free (tp);
+}
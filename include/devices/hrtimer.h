@@ -0,0 +1,36 @@
+#ifndef DEVICES_HRTIMER_H
+#define DEVICES_HRTIMER_H
+
+#include <rbtree.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/* High-resolution timers.
+ *
+ * Expiry times are in nanoseconds on the timer_ns() clock.
+ * When the local APIC timer is available each timer gets its own
+ * interrupt at its deadline; otherwise timers are checked on
+ * every PIT tick.  Expired timers' functions run as softirqs (see
+ * threads/softirq.h), so they may not sleep. */
+
+typedef void hrtimer_func (void *aux);
+
+struct hrtimer {
+	struct rb_elem elem;        /* Element in the pending tree. */
+	int64_t expires;            /* Expiry time, in ns. */
+	hrtimer_func *func;         /* Function to call at expiry. */
+	void *aux;                  /* Its argument. */
+	bool pending;               /* In the pending tree? */
+};
+
+void hrtimer_init (void);
+
+void hrtimer_setup (struct hrtimer *, hrtimer_func *, void *aux);
+void hrtimer_start (struct hrtimer *, int64_t expires);
+bool hrtimer_cancel (struct hrtimer *);
+
+bool hrtimer_sleep (int64_t ns);
+void hrtimer_tick (void);
+bool hrtimer_needs_tick (void);
+
+#endif /* devices/hrtimer.h */
@@ -0,0 +1,10 @@
+#ifndef DEVICES_IOAPIC_H
+#define DEVICES_IOAPIC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+bool ioapic_init (void);
+bool ioapic_route (int irq, uint8_t vec, uint8_t dest);
+
+#endif /* devices/ioapic.h */
@@ -0,0 +1,26 @@
+#ifndef DEVICES_LAPIC_H
+#define DEVICES_LAPIC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Interrupt vectors raised by the local APIC itself.  Like the
+   PIC's 0x20...0x2f, intr_handler() treats them as external
+   interrupts, acknowledged with lapic_eoi().  Their priority
+   class, 0xf, is the highest. */
+#define LAPIC_VEC_MIN 0xf0              /* First local APIC vector. */
+#define LAPIC_TIMER_VEC 0xf0            /* Local APIC timer. */
+#define LAPIC_SPURIOUS_VEC 0xff         /* Spurious; never acknowledged. */
+
+bool lapic_init (void);
+bool lapic_present (void);
+uint8_t lapic_id (void);
+void lapic_mask_extint (void);
+void lapic_eoi (void);
+
+bool lapic_timer_init (void);
+bool lapic_timer_has_deadline (void);
+void lapic_timer_arm (uint64_t deadline_tsc);
+void lapic_timer_disarm (void);
+
+#endif /* devices/lapic.h */
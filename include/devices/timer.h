@@ -2,6 +2,7 @@
 #define DEVICES_TIMER_H
 
 #include <round.h>
+#include <stdbool.h>
 #include <stdint.h>
 
 /* Number of timer interrupts per second. */
@@ -12,12 +13,26 @@ void timer_calibrate (void);
 
 int64_t timer_ticks (void);
 int64_t timer_elapsed (int64_t);
+int64_t timer_ns (void);
 
 void timer_sleep (int64_t ticks);
 void timer_msleep (int64_t milliseconds);
 void timer_usleep (int64_t microseconds);
 void timer_nsleep (int64_t nanoseconds);
 
+/* Time-stamp counter, calibrated by timer_calibrate(). */
+uint64_t timer_tsc_hz (void);
+int64_t timer_tsc_to_ns (uint64_t tsc);
+uint64_t timer_ns_to_tsc (int64_t ns);
+
 void timer_print_stats (void);
 
+/* Cached calibration ("-loops-per-tick=N"). */
+extern unsigned timer_loops_per_tick;
+
+/* Tickless idle ("-tickless"). */
+extern bool timer_tickless;
+void timer_idle_enter (void);
+void timer_idle_exit (void);
+
 #endif /* devices/timer.h */
@@ -0,0 +1,14 @@
+#ifndef FILESYS_TEXT_CACHE_H
+#define FILESYS_TEXT_CACHE_H
+
+#include <stdbool.h>
+#include "filesys/off_t.h"
+
+struct inode;
+
+void text_cache_init (void);
+void *text_cache_get (struct inode *, off_t ofs);
+void text_cache_invalidate (struct inode *, off_t ofs, off_t size);
+bool text_cache_shrink (void);
+
+#endif /* filesys/text-cache.h */
@@ -0,0 +1,21 @@
+#ifndef __LIB_INTR_STAT_H
+#define __LIB_INTR_STAT_H
+
+#include <stdint.h>
+
+/* Number of handler latency histogram buckets.  Bucket N counts
+   runs of [2**N, 2**(N+1)) TSC cycles; the last one also takes
+   everything longer. */
+#define INTR_STAT_HIST_CNT 24
+
+/* Accounting for one interrupt vector, filled in by the
+   intr_stat() system call and printed at power off. */
+struct intr_stat {
+	uint64_t count;                     /* Times the handler ran. */
+	uint64_t cycles;                    /* TSC cycles spent in it, in total. */
+	uint64_t max_cycles;                /* Longest single run. */
+	uint32_t hist[INTR_STAT_HIST_CNT];  /* Latency histogram, see above. */
+	char name[32];                      /* Name the handler registered. */
+};
+
+#endif /* lib/intr-stat.h */
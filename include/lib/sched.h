@@ -0,0 +1,10 @@
+#ifndef __LIB_SCHED_H
+#define __LIB_SCHED_H
+
+/* Scheduling classes, for sched_setclass(). */
+#define SCHED_NORMAL 0      /* Fixed time slice.  The default. */
+#define SCHED_BATCH 1       /* CPU-bound: a longer time slice that adapts
+                               to the thread, but any ready SCHED_NORMAL
+                               thread of equal priority goes first. */
+
+#endif /* lib/sched.h */
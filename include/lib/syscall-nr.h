@@ -36,6 +36,26 @@ enum {
 
 	SYS_MOUNT,
 	SYS_UMOUNT,
+
+	/* User-space synchronization. */
+	SYS_FUTEX_WAIT,             /* Sleep if a word holds a value. */
+	SYS_FUTEX_WAKE,             /* Wake sleepers on a word. */
+
+	/* Kernel statistics. */
+	SYS_INTR_STAT,              /* Read one interrupt vector's accounting. */
+
+	/* Scheduling. */
+	SYS_SCHED_SETCLASS,         /* Change the caller's scheduling class. */
+
+	/* Kernel statistics, continued. */
+	SYS_SYSSTAT,                /* Read one system call's accounting. */
+
+	/* Process creation. */
+	SYS_SPAWN,                  /* Start a program in a new process. */
+
+	/* New system calls go here, so that no number ever changes. */
+
+	SYS_CNT                     /* Number of system calls. */
 };
 
 #endif /* lib/syscall-nr.h */
@@ -0,0 +1,21 @@
+#ifndef __LIB_SYSCALL_STAT_H
+#define __LIB_SYSCALL_STAT_H
+
+#include <stdint.h>
+
+/* Number of latency histogram buckets.  Bucket N counts calls of
+   [2**N, 2**(N+1)) TSC cycles; the last one also takes everything
+   longer. */
+#define SYSCALL_STAT_HIST_CNT 24
+
+/* Accounting for one system call, filled in by the sysstat()
+   system call and printed at power off. */
+struct syscall_stat {
+	uint64_t calls;                     /* Times it was made. */
+	uint64_t errors;                    /* Times it failed. */
+	uint64_t cycles;                    /* TSC cycles spent in it, in total. */
+	uint32_t hist[SYSCALL_STAT_HIST_CNT]; /* Latency histogram, see above. */
+	char name[16];                      /* Its name, e.g. "read". */
+};
+
+#endif /* lib/syscall-stat.h */
@@ -0,0 +1,41 @@
+#ifndef __LIB_USER_MUTEX_H
+#define __LIB_USER_MUTEX_H
+
+#include <stdbool.h>
+
+/* Mutexes and condition variables for user programs.
+ *
+ * Both live entirely in user memory and are built on the
+ * futex_wait() and futex_wake() system calls, which are only made
+ * when a thread actually has to sleep or someone is known to be
+ * sleeping.  Locking and unlocking an uncontended mutex never
+ * enters the kernel.  A mutex or condition variable placed in
+ * memory shared between processes (for example with mmap) works
+ * across those processes. */
+
+/* Mutex. */
+struct mutex {
+	volatile int state;         /* 0: unlocked, 1: locked, 2: contended. */
+};
+
+#define MUTEX_INITIALIZER { 0 }
+
+void mutex_init (struct mutex *);
+void mutex_lock (struct mutex *);
+bool mutex_trylock (struct mutex *);
+void mutex_unlock (struct mutex *);
+
+/* Condition variable. */
+struct condvar {
+	volatile int seq;           /* Bumped by every signal. */
+	volatile int waiters;       /* # of threads in condvar_wait(). */
+};
+
+#define CONDVAR_INITIALIZER { 0, 0 }
+
+void condvar_init (struct condvar *);
+void condvar_wait (struct condvar *, struct mutex *);
+void condvar_signal (struct condvar *);
+void condvar_broadcast (struct condvar *);
+
+#endif /* lib/user/mutex.h */
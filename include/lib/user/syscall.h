@@ -4,6 +4,9 @@
 #include <stdbool.h>
 #include <debug.h>
 #include <stddef.h>
+#include <intr-stat.h>
+#include <sched.h>
+#include <syscall-stat.h>
 
 /* Process identifier. */
 typedef int pid_t;
@@ -25,6 +28,7 @@ void halt (void) NO_RETURN;
 void exit (int status) NO_RETURN;
 pid_t fork (const char *thread_name);
 int exec (const char *file);
+pid_t spawn (const char *file, char *const argv[]);
 int wait (pid_t);
 bool create (const char *file, unsigned initial_size);
 bool remove (const char *file);
@@ -50,6 +54,17 @@ bool isdir (int fd);
 int inumber (int fd);
 int symlink (const char* target, const char* linkpath);
 
+/* User-space synchronization, see <mutex.h>. */
+int futex_wait (int *addr, int expected);
+int futex_wake (int *addr, int cnt);
+
+/* Scheduling, see <sched.h>. */
+int sched_setclass (int class);
+
+/* Kernel statistics. */
+int intr_stat (int vec, struct intr_stat *);
+int sysstat (int nr, struct syscall_stat *);
+
 static inline void* get_phys_addr (void *user_addr) {
 	void* pa;
 	asm volatile ("movq %0, %%rax" ::"r"(user_addr));
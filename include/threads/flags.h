@@ -9,4 +9,10 @@
 #define FLAG_AC    (1<<18)
 #define FLAG_NT    (1<<14)
 
+/* Flags in control register 0. */
+#define CR0_PE 0x00000001      /* Protection Enable. */
+#define CR0_EM 0x00000004      /* (Floating-point) Emulation. */
+#define CR0_PG 0x80000000      /* Paging. */
+#define CR0_WP 0x00010000      /* Write-Protect enable in kernel mode. */
+
 #endif /* threads/flags.h */
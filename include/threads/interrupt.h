@@ -3,6 +3,7 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include <intr-stat.h>
 
 /* Interrupts on or off? */
 enum intr_level {
@@ -65,6 +66,17 @@ struct intr_frame {
 
 typedef void intr_handler_func (struct intr_frame *);
 
+/* External interrupt priority classes, most urgent last.  With
+   the APICs, a pending interrupt of a higher class is delivered
+   first. */
+#define INTR_CLASS_DEV 0xc              /* Keyboard, serial, other ISA. */
+#define INTR_CLASS_DISK 0xd             /* IDE channels. */
+#define INTR_CLASS_TIMER 0xe            /* PIT tick. */
+#define INTR_CLASS_LAPIC 0xf            /* Local APIC timer. */
+
+/* Use the 8259A PICs even if there are APICs ("-pic"). */
+extern bool intr_force_pic;
+
 void intr_init (void);
 void intr_register_ext (uint8_t vec, intr_handler_func *, const char *name);
 void intr_register_int (uint8_t vec, int dpl, enum intr_level,
@@ -75,4 +87,12 @@ void intr_yield_on_return (void);
 void intr_dump_frame (const struct intr_frame *);
 const char *intr_name (uint8_t vec);
 
+/* Trace interrupts-off windows ("-intr-off-trace"). */
+extern bool intr_off_trace;
+
+void intr_off_end (void);
+uint64_t intr_off_max_cycles (void);
+void intr_get_stat (uint8_t vec, struct intr_stat *);
+void intr_print_stats (void);
+
 #endif /* threads/interrupt.h */
@@ -0,0 +1,54 @@
+#ifndef THREADS_SOFTIRQ_H
+#define THREADS_SOFTIRQ_H
+
+#include <list.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Deferred work ("softirqs").
+ *
+ * An external interrupt handler runs with interrupts off, so
+ * everything it does adds to the interrupt latency of the whole
+ * system.  A handler should only do what the device needs right
+ * away (acknowledging it, reading a status register) and queue
+ * the rest as a softirq_work.  Queued work runs in priority order
+ * right after the interrupt has been acknowledged on the PIC,
+ * with interrupts on, still on the interrupted thread's stack.
+ * If too much is queued at once, the remainder is left to the
+ * "softirqd" kernel thread so that the interrupted thread is not
+ * held up indefinitely.
+ *
+ * Work runs in interrupt context: intr_context() is true, so it
+ * may not sleep, but it may call intr_yield_on_return().  A work
+ * item never runs twice at the same time, and queueing an item
+ * that is already queued does nothing. */
+
+/* Softirq priorities, highest first. */
+enum softirq_priority {
+	SOFTIRQ_HI,                 /* Timer bookkeeping. */
+	SOFTIRQ_BLOCK,              /* Block device completions. */
+	SOFTIRQ_LO,                 /* Character devices. */
+	SOFTIRQ_PRI_CNT
+};
+
+typedef void softirq_func (void *aux);
+
+/* A unit of deferred work. */
+struct softirq_work {
+	struct list_elem elem;      /* Element in a softirq queue. */
+	softirq_func *func;         /* Function to run. */
+	void *aux;                  /* Its argument. */
+	bool queued;                /* In a queue right now? */
+};
+
+void softirq_init (void);
+void softirq_work_init (struct softirq_work *, softirq_func *, void *aux);
+void softirq_queue (struct softirq_work *, enum softirq_priority);
+
+void softirq_start (void);
+void softirq_run (void);
+bool softirq_context (void);
+struct thread *softirq_thread (void);
+void softirq_print_stats (void);
+
+#endif /* threads/softirq.h */
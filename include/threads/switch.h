@@ -0,0 +1,35 @@
+#ifndef THREADS_SWITCH_H
+#define THREADS_SWITCH_H
+
+#ifndef __ASSEMBLER__
+#include <stdint.h>
+
+/* switch_threads()'s stack frame.
+ *
+ * Only the registers that the SysV x86-64 calling convention
+ * requires a callee to preserve are saved here; everything else
+ * is already dead at the call site in schedule().  Segment
+ * selectors and rflags never differ between two kernel threads,
+ * so they are not saved either. */
+struct switch_threads_frame {
+	uint64_t r15;                       /*  0: Saved %r15. */
+	uint64_t r14;                       /*  8: Saved %r14. */
+	uint64_t r13;                       /* 16: Saved %r13. */
+	uint64_t r12;                       /* 24: Saved %r12. */
+	uint64_t rbx;                       /* 32: Saved %rbx. */
+	uint64_t rbp;                       /* 40: Saved %rbp. */
+	void (*rip) (void);                 /* 48: Return address. */
+};
+
+/* Switches from CUR, which must be the running thread, to NEXT,
+   which must also be running switch_threads(), returning CUR in
+   NEXT's context. */
+struct thread *switch_threads (struct thread *cur, struct thread *next);
+
+/* Entry point of a new thread: the first switch_threads() into
+   it "returns" here.  Calls the function in the frame's %r12 with
+   %r13 and %r14 as its two arguments. */
+void switch_entry (void);
+#endif
+
+#endif /* threads/switch.h */
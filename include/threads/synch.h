@@ -2,12 +2,13 @@
 #define THREADS_SYNCH_H
 
 #include <list.h>
+#include <rbtree.h>
 #include <stdbool.h>
 
 /* A counting semaphore. */
 struct semaphore {
 	unsigned value;             /* Current value. */
-	struct list waiters;        /* List of waiting threads. */
+	struct rb_tree waiters;     /* Waiting threads, highest priority first. */
 };
 
 void sema_init (struct semaphore *, unsigned value);
@@ -20,6 +21,7 @@ void sema_self_test (void);
 struct lock {
 	struct thread *holder;      /* Thread holding lock (for debugging). */
 	struct semaphore semaphore; /* Binary semaphore controlling access. */
+	struct list_elem elem;      /* Element in holder's held_locks. */
 };
 
 void lock_init (struct lock *);
@@ -30,7 +32,7 @@ bool lock_held_by_current_thread (const struct lock *);
 
 /* Condition variable. */
 struct condition {
-	struct list waiters;        /* List of waiting threads. */
+	struct rb_tree waiters;     /* Waiting threads, highest priority first. */
 };
 
 void cond_init (struct condition *);
@@ -38,6 +40,44 @@ void cond_wait (struct condition *, struct lock *);
 void cond_signal (struct condition *, struct lock *);
 void cond_broadcast (struct condition *, struct lock *);
 
+/* Reader-writer lock.  Any number of readers or a single writer
+   may hold it.  Writers are preferred: once a writer is waiting,
+   new readers queue behind it.  Threads waiting for the lock
+   donate their priority to every thread holding it. */
+struct rwlock {
+	int readers;                /* # of threads holding it shared. */
+	struct thread *writer;      /* Thread holding it exclusive, or null. */
+	struct list holders;        /* struct rwlock_hold of every holder. */
+	struct rb_tree read_waiters;  /* Blocked readers, best first. */
+	struct rb_tree write_waiters; /* Blocked writers, best first. */
+};
+
+/* One thread's hold on an rwlock.  Each thread has a few of
+   these (thread->rw_holds) so that a writer waiting for the
+   lock can find, and donate to, every reader holding it. */
+struct rwlock_hold {
+	struct rwlock *rwlock;      /* Lock held, or null if slot is free. */
+	struct thread *thread;      /* Holding thread. */
+	struct list_elem elem;      /* Element in rwlock->holders. */
+};
+
+/* Most rwlocks one thread holds at once with donation.  The file
+   system nests at most two (a directory's, then open_inodes_lock
+   in inode.c).  A thread that holds more still gets the lock, but
+   as an untracked holder that its waiters cannot donate to. */
+#define RWLOCK_HOLD_MAX 4
+
+void rwlock_init (struct rwlock *);
+void rwlock_acquire_read (struct rwlock *);
+void rwlock_release_read (struct rwlock *);
+void rwlock_acquire_write (struct rwlock *);
+void rwlock_release_write (struct rwlock *);
+bool rwlock_held_by_current_thread (const struct rwlock *);
+void rwlock_refresh_holders (struct rwlock *);
+
+struct thread;
+void synch_requeue (struct thread *);
+
 /* Optimization barrier.
  *
  * The compiler will not reorder operations across an
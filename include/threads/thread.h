@@ -3,8 +3,11 @@
 
 #include <debug.h>
 #include <list.h>
+#include <rbtree.h>
+#include <sched.h>
 #include <stdint.h>
 #include "threads/interrupt.h"
+#include "threads/synch.h"
 #ifdef VM
 #include "vm/vm.h"
 
@@ -31,6 +34,10 @@ typedef int tid_t;
 #define PRI_DEFAULT 31                  /* Default priority. */
 #define PRI_MAX 63                      /* Highest priority. */
 
+/* Thread niceness. */
+#define NICE_MIN -20                    /* Nicest. */
+#define NICE_MAX 20                     /* Least nice. */
+
 
 /* A kernel thread or user process.
  *
@@ -95,24 +102,38 @@ struct thread {
 	enum thread_status status;          /* Thread state. */
 	char name[16];                      /* Name (for debugging purposes). */
 	int priority;                       /* Priority. */
-	int wakeup;
+	int64_t wakeup;                     /* Tick to wake up at (timer.c). */
 
 	int init_priority; //donation을 대비해 원래의 priority 값 저장
 	struct lock *wait_on_lock; //해당스레드가 현재 얻기 위해 기다리는 lock. 
-	struct list donations; //priority를 내어준 스레드의 리스트
-	struct list_elem donation_elem;//donations 리스트를 요소를 관리
+	struct list held_locks; //보유 중인 lock 리스트 (lock->elem), donation 계산용
 
 	int nice;
 	int recent_cpu;
+	int64_t recent_cpu_epoch;           /* Last MLFQS decay applied to recent_cpu. */
+	int sched_class;                    /* SCHED_NORMAL or SCHED_BATCH. */
+	int quantum;                        /* Time slice, in ticks (SCHED_BATCH). */
+	int64_t vruntime;                   /* CFS weighted run time. */
+	struct rb_elem cfs_elem;            /* CFS run queue element. */
 	struct list_elem allelem;
 	
 	/* Shared between thread.c and synch.c. */
 	struct list_elem elem;              /* List element. */
 
+	/* Owned by synch.c. */
+	struct rb_tree *wait_queue;         /* Waiter tree we are blocked in. */
+	struct condition *wait_cond;        /* Condition we are waiting on. */
+	struct rb_elem *wait_cond_elem;     /* Our waiter in wait_cond->waiters. */
+	struct rb_elem wait_elem;           /* Element in *wait_queue. */
+	struct rwlock *wait_on_rwlock;      /* rwlock we are blocked on. */
+	struct rwlock_hold rw_holds[RWLOCK_HOLD_MAX]; /* rwlocks we hold. */
+
 
 #ifdef USERPROG
 	/* Owned by userprog/process.c. */
 	uint64_t *pml4;                     /* Page map level 4 */
+	struct file *exec_file;             /* Executable, denied writes. */
+	struct list segments;               /* Its segments, mapped on use. */
 #endif
 #ifdef VM
 	/* Table for whole virtual memory owned by thread. */
@@ -120,7 +141,8 @@ struct thread {
 #endif
 
 	/* Owned by thread.c. */
-	struct intr_frame tf;               /* Information for switching */
+	uint64_t ksp;                       /* Saved kernel stack pointer (switch.S). */
+	struct intr_frame tf;               /* User context for do_iret(). */
 	unsigned magic;                     /* Detects stack overflow. */
 };
 
@@ -129,10 +151,17 @@ struct thread {
    Controlled by kernel command-line option "-o mlfqs". */
 extern bool thread_mlfqs;
 
+/* If true, use the completely fair scheduler.
+   Controlled by kernel command-line option "-cfs". */
+extern bool thread_cfs;
+extern int cfs_latency;
+extern int cfs_min_granularity;
+
 void thread_init (void);
 void thread_start (void);
 
 void thread_tick (void);
+void thread_tick_idle (int64_t cnt);
 void thread_print_stats (void);
 
 typedef void thread_func (void *aux);
@@ -151,6 +180,9 @@ void thread_yield (void);
 int thread_get_priority (void);
 void thread_set_priority (int);
 
+int thread_set_class (int class);
+int thread_get_class (void);
+
 int thread_get_nice (void);
 void thread_set_nice (int);
 int thread_get_recent_cpu (void);
@@ -161,22 +193,13 @@ void do_iret (struct intr_frame *tf);
 void thread_sleep(int64_t ticks);
 void thread_awake(int64_t ticks);
 
-extern struct list ready_list;
-extern struct list sleep_list;
-
 
 void check_preemption(void);
-bool sema_priority(const struct list_elem *a, const struct list_elem *b, void *aux);
-bool thread_compare_priority(struct list_elem *a, struct list_elem *b, void *aux UNUSED);
-
-void donate_priority(void);
-void remove_with_lock(struct lock *lock);
-void refresh_priority(void);
+void thread_change_priority (struct thread *, int priority);
 
+void thread_refresh_priority (struct thread *);
 
-void refresh_priority(void);
 void mlfqs_priority (struct thread *t) ;
-void mlfqs_recent_cpu (struct thread *t) ;
 void mlfqs_load_avg (void) ;
 void mlfqs_increment (void) ;
 void mlfqs_recalc_recent_cpu (void) ;
@@ -5,9 +5,11 @@
 
 tid_t process_create_initd (const char *file_name);
 tid_t process_fork (const char *name, struct intr_frame *if_);
+tid_t process_spawn (const char *path, char *const *argv);
 int process_exec (void *f_name);
 int process_wait (tid_t);
 void process_exit (void);
 void process_activate (struct thread *next);
+bool process_load_page (const void *uaddr);
 
 #endif /* userprog/process.h */
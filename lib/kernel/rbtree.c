@@ -0,0 +1,309 @@
+/* Red-black tree.
+
+   The algorithms follow Cormen, Leiserson, Rivest and Stein,
+   "Introduction to Algorithms", chapter 13, using null pointers
+   instead of a sentinel for the leaves.
+
+   See rbtree.h for basic information. */
+
+#include "rbtree.h"
+#include "../debug.h"
+
+static void rotate_left (struct rb_tree *, struct rb_elem *);
+static void rotate_right (struct rb_tree *, struct rb_elem *);
+static void replace_child (struct rb_tree *, struct rb_elem *parent,
+		struct rb_elem *old, struct rb_elem *new);
+static void insert_fixup (struct rb_tree *, struct rb_elem *);
+static void remove_fixup (struct rb_tree *, struct rb_elem *x,
+		struct rb_elem *parent);
+static struct rb_elem *subtree_min (struct rb_elem *);
+
+/* Returns true if E is a red node.  Leaves are black. */
+static inline bool
+is_red (const struct rb_elem *e) {
+	return e != NULL && e->red;
+}
+
+/* Initializes T as an empty tree ordered by LESS, given auxiliary
+   data AUX. */
+void
+rb_init (struct rb_tree *t, rb_less_func *less, void *aux) {
+	ASSERT (t != NULL);
+	ASSERT (less != NULL);
+
+	t->root = NULL;
+	t->leftmost = NULL;
+	t->elem_cnt = 0;
+	t->less = less;
+	t->aux = aux;
+}
+
+/* Inserts E into T.  E goes after every element that compares
+   equal to it. */
+void
+rb_insert (struct rb_tree *t, struct rb_elem *e) {
+	struct rb_elem **link = &t->root;
+	struct rb_elem *parent = NULL;
+	bool leftmost = true;
+
+	ASSERT (t != NULL);
+	ASSERT (e != NULL);
+
+	while (*link != NULL) {
+		parent = *link;
+		if (t->less (e, parent, t->aux))
+			link = &parent->left;
+		else {
+			link = &parent->right;
+			leftmost = false;
+		}
+	}
+
+	e->parent = parent;
+	e->left = e->right = NULL;
+	e->red = true;
+	*link = e;
+	if (leftmost)
+		t->leftmost = e;
+	t->elem_cnt++;
+
+	insert_fixup (t, e);
+}
+
+/* Removes E, which must be in T, from T. */
+void
+rb_remove (struct rb_tree *t, struct rb_elem *e) {
+	struct rb_elem *x, *x_parent;
+	bool removed_red = e->red;
+
+	ASSERT (t != NULL);
+	ASSERT (e != NULL);
+	ASSERT (t->elem_cnt > 0);
+
+	if (t->leftmost == e)
+		t->leftmost = rb_next (e);
+
+	if (e->left == NULL || e->right == NULL) {
+		/* At most one child: splice E out. */
+		x = e->left != NULL ? e->left : e->right;
+		x_parent = e->parent;
+		replace_child (t, e->parent, e, x);
+		if (x != NULL)
+			x->parent = e->parent;
+	} else {
+		/* Two children: move E's successor Y into E's place. */
+		struct rb_elem *y = subtree_min (e->right);
+
+		removed_red = y->red;
+		x = y->right;
+		if (y->parent == e)
+			x_parent = y;
+		else {
+			x_parent = y->parent;
+			replace_child (t, y->parent, y, x);
+			if (x != NULL)
+				x->parent = y->parent;
+			y->right = e->right;
+			y->right->parent = y;
+		}
+		replace_child (t, e->parent, e, y);
+		y->parent = e->parent;
+		y->left = e->left;
+		y->left->parent = y;
+		y->red = e->red;
+	}
+
+	if (!removed_red)
+		remove_fixup (t, x, x_parent);
+	t->elem_cnt--;
+}
+
+/* Returns the smallest element in T, or a null pointer if T is
+   empty. */
+struct rb_elem *
+rb_min (const struct rb_tree *t) {
+	return t->leftmost;
+}
+
+/* Returns the element that follows E in its tree, or a null
+   pointer if E is the greatest. */
+struct rb_elem *
+rb_next (struct rb_elem *e) {
+	ASSERT (e != NULL);
+
+	if (e->right != NULL)
+		return subtree_min (e->right);
+	while (e->parent != NULL && e == e->parent->right)
+		e = e->parent;
+	return e->parent;
+}
+
+/* Returns the number of elements in T. */
+size_t
+rb_size (const struct rb_tree *t) {
+	return t->elem_cnt;
+}
+
+/* Returns true if T contains no elements, false otherwise. */
+bool
+rb_empty (const struct rb_tree *t) {
+	return t->elem_cnt == 0;
+}
+
+/* Returns the smallest element in the subtree rooted at E. */
+static struct rb_elem *
+subtree_min (struct rb_elem *e) {
+	while (e->left != NULL)
+		e = e->left;
+	return e;
+}
+
+/* Makes NEW take OLD's place as a child of PARENT, or as T's root
+   if PARENT is null.  Does not update NEW->parent. */
+static void
+replace_child (struct rb_tree *t, struct rb_elem *parent,
+		struct rb_elem *old, struct rb_elem *new) {
+	if (parent == NULL)
+		t->root = new;
+	else if (parent->left == old)
+		parent->left = new;
+	else
+		parent->right = new;
+}
+
+/* Rotates the subtree rooted at X to the left. */
+static void
+rotate_left (struct rb_tree *t, struct rb_elem *x) {
+	struct rb_elem *y = x->right;
+
+	x->right = y->left;
+	if (y->left != NULL)
+		y->left->parent = x;
+	y->parent = x->parent;
+	replace_child (t, x->parent, x, y);
+	y->left = x;
+	x->parent = y;
+}
+
+/* Rotates the subtree rooted at X to the right. */
+static void
+rotate_right (struct rb_tree *t, struct rb_elem *x) {
+	struct rb_elem *y = x->left;
+
+	x->left = y->right;
+	if (y->right != NULL)
+		y->right->parent = x;
+	y->parent = x->parent;
+	replace_child (t, x->parent, x, y);
+	y->right = x;
+	x->parent = y;
+}
+
+/* Restores the red-black properties after inserting red node E. */
+static void
+insert_fixup (struct rb_tree *t, struct rb_elem *e) {
+	struct rb_elem *p;
+
+	while ((p = e->parent) != NULL && p->red) {
+		struct rb_elem *g = p->parent;
+
+		if (p == g->left) {
+			struct rb_elem *u = g->right;
+			if (is_red (u)) {
+				p->red = u->red = false;
+				g->red = true;
+				e = g;
+				continue;
+			}
+			if (e == p->right) {
+				rotate_left (t, p);
+				e = p;
+				p = e->parent;
+			}
+			p->red = false;
+			g->red = true;
+			rotate_right (t, g);
+		} else {
+			struct rb_elem *u = g->left;
+			if (is_red (u)) {
+				p->red = u->red = false;
+				g->red = true;
+				e = g;
+				continue;
+			}
+			if (e == p->left) {
+				rotate_right (t, p);
+				e = p;
+				p = e->parent;
+			}
+			p->red = false;
+			g->red = true;
+			rotate_left (t, g);
+		}
+	}
+	t->root->red = false;
+}
+
+/* Restores the red-black properties after a black node was
+   removed.  X, which may be null, took its place as a child of
+   PARENT and carries an extra black. */
+static void
+remove_fixup (struct rb_tree *t, struct rb_elem *x, struct rb_elem *parent) {
+	while (x != t->root && !is_red (x)) {
+		if (x == parent->left) {
+			struct rb_elem *w = parent->right;
+			if (w->red) {
+				w->red = false;
+				parent->red = true;
+				rotate_left (t, parent);
+				w = parent->right;
+			}
+			if (!is_red (w->left) && !is_red (w->right)) {
+				w->red = true;
+				x = parent;
+				parent = x->parent;
+			} else {
+				if (!is_red (w->right)) {
+					w->left->red = false;
+					w->red = true;
+					rotate_right (t, w);
+					w = parent->right;
+				}
+				w->red = parent->red;
+				parent->red = false;
+				if (w->right != NULL)
+					w->right->red = false;
+				rotate_left (t, parent);
+				x = t->root;
+			}
+		} else {
+			struct rb_elem *w = parent->left;
+			if (w->red) {
+				w->red = false;
+				parent->red = true;
+				rotate_right (t, parent);
+				w = parent->left;
+			}
+			if (!is_red (w->left) && !is_red (w->right)) {
+				w->red = true;
+				x = parent;
+				parent = x->parent;
+			} else {
+				if (!is_red (w->left)) {
+					w->right->red = false;
+					w->red = true;
+					rotate_left (t, w);
+					w = parent->left;
+				}
+				w->red = parent->red;
+				parent->red = false;
+				if (w->left != NULL)
+					w->left->red = false;
+				rotate_right (t, parent);
+				x = t->root;
+			}
+		}
+	}
+	if (x != NULL)
+		x->red = false;
+}
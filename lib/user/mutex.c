@@ -0,0 +1,92 @@
+/* Mutexes and condition variables on top of futexes.
+
+   The mutex is the three-state design from Ulrich Drepper,
+   "Futexes Are Tricky": the state word says whether the mutex is
+   free, held, or held with (possibly) sleeping waiters, and only
+   the last case costs a system call on unlock. */
+
+#include <mutex.h>
+#include <syscall.h>
+
+/* Initializes M as unlocked. */
+void
+mutex_init (struct mutex *m) {
+	m->state = 0;
+}
+
+/* Acquires M, sleeping in the kernel only if it is held. */
+void
+mutex_lock (struct mutex *m) {
+	int c = __sync_val_compare_and_swap (&m->state, 0, 1);
+
+	if (c == 0)
+		return;
+
+	/* Contended: mark the mutex as having waiters and sleep until
+	   we are the one that finds it free. */
+	if (c != 2)
+		c = __atomic_exchange_n (&m->state, 2, __ATOMIC_ACQUIRE);
+	while (c != 0) {
+		futex_wait ((int *) &m->state, 2);
+		c = __atomic_exchange_n (&m->state, 2, __ATOMIC_ACQUIRE);
+	}
+}
+
+/* Acquires M if it is free.  Returns true if successful, false if
+   M is held.  Never sleeps. */
+bool
+mutex_trylock (struct mutex *m) {
+	return __sync_bool_compare_and_swap (&m->state, 0, 1);
+}
+
+/* Releases M, waking one waiter if there may be any. */
+void
+mutex_unlock (struct mutex *m) {
+	if (__atomic_fetch_sub (&m->state, 1, __ATOMIC_RELEASE) != 1) {
+		m->state = 0;
+		futex_wake ((int *) &m->state, 1);
+	}
+}
+
+/* Initializes CV with no waiters. */
+void
+condvar_init (struct condvar *cv) {
+	cv->seq = 0;
+	cv->waiters = 0;
+}
+
+/* Atomically releases M and waits for CV to be signaled, then
+   reacquires M.  As with any condition variable, the caller must
+   recheck its condition after returning. */
+void
+condvar_wait (struct condvar *cv, struct mutex *m) {
+	int seq = cv->seq;
+
+	__atomic_fetch_add (&cv->waiters, 1, __ATOMIC_RELAXED);
+	mutex_unlock (m);
+	futex_wait ((int *) &cv->seq, seq);
+	__atomic_fetch_sub (&cv->waiters, 1, __ATOMIC_RELAXED);
+
+	/* Others may have been woken with us, so take M as contended
+	   to make sure its eventual unlock wakes them in turn. */
+	while (__atomic_exchange_n (&m->state, 2, __ATOMIC_ACQUIRE) != 0)
+		futex_wait ((int *) &m->state, 2);
+}
+
+/* Wakes one thread waiting on CV, if any.  Does not enter the
+   kernel when nobody is waiting. */
+void
+condvar_signal (struct condvar *cv) {
+	__atomic_fetch_add (&cv->seq, 1, __ATOMIC_RELEASE);
+	if (cv->waiters > 0)
+		futex_wake ((int *) &cv->seq, 1);
+}
+
+/* Wakes every thread waiting on CV.  Does not enter the kernel
+   when nobody is waiting. */
+void
+condvar_broadcast (struct condvar *cv) {
+	__atomic_fetch_add (&cv->seq, 1, __ATOMIC_RELEASE);
+	if (cv->waiters > 0)
+		futex_wake ((int *) &cv->seq, 0x7fffffff);
+}
@@ -90,6 +90,11 @@ exec (const char *file) {
 	return (pid_t) syscall1 (SYS_EXEC, file);
 }
 
+pid_t
+spawn (const char *file, char *const argv[]) {
+	return (pid_t) syscall2 (SYS_SPAWN, file, argv);
+}
+
 int
 wait (pid_t pid) {
 	return syscall1 (SYS_WAIT, pid);
@@ -194,3 +199,28 @@ int
 umount (const char *path) {
 	return syscall1 (SYS_UMOUNT, path);
 }
+
+int
+futex_wait (int *addr, int expected) {
+	return syscall2 (SYS_FUTEX_WAIT, addr, expected);
+}
+
+int
+futex_wake (int *addr, int cnt) {
+	return syscall2 (SYS_FUTEX_WAKE, addr, cnt);
+}
+
+int
+sched_setclass (int class) {
+	return syscall1 (SYS_SCHED_SETCLASS, class);
+}
+
+int
+intr_stat (int vec, struct intr_stat *stat) {
+	return syscall2 (SYS_INTR_STAT, vec, stat);
+}
+
+int
+sysstat (int nr, struct syscall_stat *stat) {
+	return syscall2 (SYS_SYSSTAT, nr, stat);
+}
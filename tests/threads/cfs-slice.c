@@ -0,0 +1,120 @@
+/* Checks the length of the slices the completely fair scheduler
+   hands out: each of N equally weighted busy threads should run
+   for -cfs-latency / N ticks at a time, but never for fewer than
+   -cfs-granularity ticks.
+
+   cfs-slice-latency runs 4 threads under -cfs-latency=20
+   -cfs-granularity=1, so each should run 5 ticks at a time.
+
+   cfs-slice-granularity runs 8 threads under -cfs-latency=8
+   -cfs-granularity=4.  Their share of the latency is 1 tick, so
+   the granularity should stretch each run to 4 ticks.
+
+   Each thread spins, noting every tick it sees.  A run is a
+   stretch of consecutive ticks; a gap means another thread ran.
+   The thread reports the run length it saw most often, which
+   shrugs off the odd run cut short by the main thread or a
+   kernel thread. */
+
+#include <stdio.h>
+#include <inttypes.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+static void test_cfs_slice (int thread_cnt);
+
+void
+test_cfs_slice_latency (void) 
+{
+  test_cfs_slice (4);
+}
+
+void
+test_cfs_slice_granularity (void) 
+{
+  test_cfs_slice (8);
+}
+
+#define MAX_THREAD_CNT 8
+#define MAX_RUN 32
+
+struct thread_info 
+  {
+    int64_t start_time;
+    int runs[MAX_RUN + 1];      /* runs[N]: # of runs of N ticks. */
+  };
+
+static void spin_thread (void *aux);
+
+static void
+test_cfs_slice (int thread_cnt)
+{
+  struct thread_info info[MAX_THREAD_CNT];
+  int64_t start_time;
+  int i, n;
+
+  ASSERT (thread_cfs);
+  ASSERT (thread_cnt <= MAX_THREAD_CNT);
+
+  msg ("Latency %d ticks, granularity %d ticks, %d threads.",
+       cfs_latency, cfs_min_granularity, thread_cnt);
+
+  start_time = timer_ticks ();
+  for (i = 0; i < thread_cnt; i++) 
+    {
+      struct thread_info *ti = &info[i];
+      char name[16];
+
+      ti->start_time = start_time;
+      for (n = 0; n <= MAX_RUN; n++)
+        ti->runs[n] = 0;
+
+      snprintf (name, sizeof name, "spin %d", i);
+      thread_create (name, PRI_DEFAULT, spin_thread, ti);
+    }
+
+  msg ("Sleeping 15 seconds to let threads run, please wait...");
+  timer_sleep (15 * TIMER_FREQ);
+
+  for (i = 0; i < thread_cnt; i++) 
+    {
+      int mode = 1;
+
+      for (n = 1; n <= MAX_RUN; n++)
+        if (info[i].runs[n] > info[i].runs[mode])
+          mode = n;
+      msg ("Thread %d mostly ran %d ticks at a time.", i, mode);
+    }
+}
+
+static void
+spin_thread (void *ti_) 
+{
+  struct thread_info *ti = ti_;
+  int64_t sleep_time = 2 * TIMER_FREQ;
+  int64_t spin_time = sleep_time + 10 * TIMER_FREQ;
+  int64_t last_time;
+  int run = 1;
+  bool first = true;
+
+  timer_sleep (sleep_time - timer_elapsed (ti->start_time));
+  last_time = timer_ticks ();
+  while (timer_elapsed (ti->start_time) < spin_time) 
+    {
+      int64_t cur_time = timer_ticks ();
+      if (cur_time == last_time + 1)
+        run++;
+      else if (cur_time > last_time + 1) 
+        {
+          /* Another thread ran in between.  The first run may have
+             started part way through a slice, so skip it. */
+          if (!first)
+            ti->runs[run < MAX_RUN ? run : MAX_RUN]++;
+          first = false;
+          run = 1;
+        }
+      last_time = cur_time;
+    }
+}
@@ -0,0 +1,73 @@
+/* The main thread and a "reader" thread both hold an rwlock for
+   reading, and the reader then blocks on a semaphore.  A
+   higher-priority writer blocks acquiring the lock, donating its
+   priority to both readers.  The main thread gives its priority
+   back when it releases the lock, but the reader keeps the
+   donation until it releases the lock too, which hands the lock
+   to the writer. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+struct rwlock_and_sema 
+  {
+    struct rwlock rw;
+    struct semaphore sema;
+  };
+
+static thread_func reader_thread_func;
+static thread_func writer_thread_func;
+
+void
+test_rwlock_donate (void) 
+{
+  struct rwlock_and_sema rs;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Make sure our priority is the default. */
+  ASSERT (thread_get_priority () == PRI_DEFAULT);
+
+  rwlock_init (&rs.rw);
+  sema_init (&rs.sema, 0);
+  rwlock_acquire_read (&rs.rw);
+  thread_create ("reader", PRI_DEFAULT + 1, reader_thread_func, &rs);
+  thread_create ("writer", PRI_DEFAULT + 3, writer_thread_func, &rs);
+  msg ("This thread should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT + 3, thread_get_priority ());
+  rwlock_release_read (&rs.rw);
+  msg ("This thread should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT, thread_get_priority ());
+  sema_up (&rs.sema);
+  msg ("writer, reader must already have finished, in that order.");
+  msg ("This should be the last line before finishing this test.");
+}
+
+static void
+reader_thread_func (void *rs_) 
+{
+  struct rwlock_and_sema *rs = rs_;
+
+  rwlock_acquire_read (&rs->rw);
+  msg ("reader: got the lock");
+  sema_down (&rs->sema);
+  msg ("reader: should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT + 3, thread_get_priority ());
+  rwlock_release_read (&rs->rw);
+  msg ("reader: done, with priority %d", thread_get_priority ());
+}
+
+static void
+writer_thread_func (void *rs_) 
+{
+  struct rwlock_and_sema *rs = rs_;
+
+  rwlock_acquire_write (&rs->rw);
+  msg ("writer: got the lock");
+  rwlock_release_write (&rs->rw);
+  msg ("writer: done");
+}
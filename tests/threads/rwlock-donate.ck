@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(rwlock-donate) begin
+(rwlock-donate) reader: got the lock
+(rwlock-donate) This thread should have priority 34.  Actual priority: 34.
+(rwlock-donate) This thread should have priority 31.  Actual priority: 31.
+(rwlock-donate) reader: should have priority 34.  Actual priority: 34.
+(rwlock-donate) writer: got the lock
+(rwlock-donate) writer: done
+(rwlock-donate) reader: done, with priority 32
+(rwlock-donate) writer, reader must already have finished, in that order.
+(rwlock-donate) This should be the last line before finishing this test.
+(rwlock-donate) end
+EOF
+pass;
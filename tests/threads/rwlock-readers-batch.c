@@ -0,0 +1,65 @@
+/* The main thread acquires an rwlock for writing.  Then it
+   creates a writer and three readers, all of higher priority,
+   which block acquiring the lock.  The readers outrank the
+   writer, so when the main thread releases the lock, all three
+   readers must be granted it together: each, as it runs, should
+   see the ones that have not run yet still holding the lock.
+   The writer gets it only once the last reader is out. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+static thread_func writer_thread_func;
+static thread_func reader_thread_func;
+
+void
+test_rwlock_readers_batch (void) 
+{
+  struct rwlock rw;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Make sure our priority is the default. */
+  ASSERT (thread_get_priority () == PRI_DEFAULT);
+
+  rwlock_init (&rw);
+  rwlock_acquire_write (&rw);
+  thread_create ("writer", PRI_DEFAULT + 1, writer_thread_func, &rw);
+  for (i = 0; i < 3; i++) 
+    {
+      char name[16];
+      snprintf (name, sizeof name, "reader %d", i);
+      thread_create (name, PRI_DEFAULT + 2 + i, reader_thread_func, &rw);
+    }
+  msg ("This thread should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT + 4, thread_get_priority ());
+  rwlock_release_write (&rw);
+  msg ("readers, writer must already have finished, in that order.");
+  msg ("This should be the last line before finishing this test.");
+}
+
+static void
+writer_thread_func (void *rw_) 
+{
+  struct rwlock *rw = rw_;
+
+  rwlock_acquire_write (rw);
+  msg ("writer: got the lock");
+  rwlock_release_write (rw);
+  msg ("writer: done");
+}
+
+static void
+reader_thread_func (void *rw_) 
+{
+  struct rwlock *rw = rw_;
+
+  rwlock_acquire_read (rw);
+  msg ("%s: got the lock with %d readers", thread_name (), rw->readers);
+  rwlock_release_read (rw);
+}
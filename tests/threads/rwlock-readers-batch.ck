@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(rwlock-readers-batch) begin
+(rwlock-readers-batch) This thread should have priority 35.  Actual priority: 35.
+(rwlock-readers-batch) reader 2: got the lock with 3 readers
+(rwlock-readers-batch) reader 1: got the lock with 2 readers
+(rwlock-readers-batch) reader 0: got the lock with 1 readers
+(rwlock-readers-batch) writer: got the lock
+(rwlock-readers-batch) writer: done
+(rwlock-readers-batch) readers, writer must already have finished, in that order.
+(rwlock-readers-batch) This should be the last line before finishing this test.
+(rwlock-readers-batch) end
+EOF
+pass;
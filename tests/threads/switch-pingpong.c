@@ -0,0 +1,59 @@
+/* Context-switch microbenchmark.  Makes control "ping-pong"
+   between a pair of threads through two semaphores, the same way
+   sema_self_test() does, and reports how many thread switches per
+   second the scheduler sustains.  Every round trip is exactly two
+   switches: main -> helper -> main. */
+
+#include <stdio.h>
+#include <inttypes.h>
+#include "tests/threads/tests.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define ROUND_TRIPS 100000
+
+static thread_func pong;
+
+void
+test_switch_pingpong (void) 
+{
+  struct semaphore sema[2];
+  int64_t start, elapsed_us;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  sema_init (&sema[0], 0);
+  sema_init (&sema[1], 0);
+  thread_create ("pong", PRI_DEFAULT, pong, &sema);
+
+  start = timer_ns ();
+  for (i = 0; i < ROUND_TRIPS; i++) 
+    {
+      sema_up (&sema[0]);
+      sema_down (&sema[1]);
+    }
+  elapsed_us = (timer_ns () - start) / 1000;
+  if (elapsed_us < 1)
+    elapsed_us = 1;
+
+  msg ("%d switches in %"PRId64" us", 2 * ROUND_TRIPS, elapsed_us);
+  msg ("%"PRId64" switches/sec",
+       (int64_t) 2 * ROUND_TRIPS * 1000000 / elapsed_us);
+  pass ();
+}
+
+static void
+pong (void *sema_) 
+{
+  struct semaphore *sema = sema_;
+  int i;
+
+  for (i = 0; i < ROUND_TRIPS; i++) 
+    {
+      sema_down (&sema[0]);
+      sema_up (&sema[1]);
+    }
+}
@@ -29,6 +29,15 @@ static const struct test tests[] =
     {"priority-preempt", test_priority_preempt},
     {"priority-sema", test_priority_sema},
     {"priority-condvar", test_priority_condvar},
+    {"switch-pingpong", test_switch_pingpong},
+    {"rwlock-writer-pref", test_rwlock_writer_pref},
+    {"rwlock-readers-batch", test_rwlock_readers_batch},
+    {"rwlock-donate", test_rwlock_donate},
+    {"cfs-fair-2", test_cfs_fair_2},
+    {"cfs-nice-2", test_cfs_nice_2},
+    {"cfs-nice-3", test_cfs_nice_3},
+    {"cfs-slice-latency", test_cfs_slice_latency},
+    {"cfs-slice-granularity", test_cfs_slice_granularity},
     {"mlfqs-load-1", test_mlfqs_load_1},
     {"mlfqs-load-60", test_mlfqs_load_60},
     {"mlfqs-load-avg", test_mlfqs_load_avg},
@@ -23,6 +23,15 @@ extern test_func test_priority_fifo;
 extern test_func test_priority_preempt;
 extern test_func test_priority_sema;
 extern test_func test_priority_condvar;
+extern test_func test_switch_pingpong;
+extern test_func test_rwlock_writer_pref;
+extern test_func test_rwlock_readers_batch;
+extern test_func test_rwlock_donate;
+extern test_func test_cfs_fair_2;
+extern test_func test_cfs_nice_2;
+extern test_func test_cfs_nice_3;
+extern test_func test_cfs_slice_latency;
+extern test_func test_cfs_slice_granularity;
 extern test_func test_mlfqs_load_1;
 extern test_func test_mlfqs_load_60;
 extern test_func test_mlfqs_load_avg;
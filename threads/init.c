@@ -1,6 +1,7 @@
 #include "threads/init.h"
 #include <console.h>
 #include <debug.h>
+#include <inttypes.h>
 #include <limits.h>
 #include <random.h>
 #include <stddef.h>
@@ -8,11 +9,13 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "devices/hrtimer.h"
 #include "devices/kbd.h"
 #include "devices/input.h"
 #include "devices/serial.h"
 #include "devices/timer.h"
 #include "devices/vga.h"
+#include "threads/flags.h"
 #include "threads/interrupt.h"
 #include "threads/io.h"
 #include "threads/loader.h"
@@ -20,7 +23,9 @@
 #include "threads/mmu.h"
 #include "threads/palloc.h"
 #include "threads/pte.h"
+#include "threads/softirq.h"
 #include "threads/thread.h"
+#include "intrinsic.h"
 #ifdef USERPROG
 #include "userprog/process.h"
 #include "userprog/exception.h"
@@ -103,8 +108,10 @@ main (void) {
 #endif
 	/* Start thread scheduler and enable interrupts. */
 	thread_start ();
+	softirq_start ();
 	serial_init_queue ();
 	timer_calibrate ();
+	hrtimer_init ();
 
 #ifdef FILESYS
 	/* Initialize file system. */
@@ -116,6 +123,9 @@ main (void) {
 	vm_init ();
 #endif
 
+	/* Timer calibration's share is on the "Calibrating timer"
+	   line. */
+	printf ("Boot took %'"PRId64" us since timer_init().\n", timer_ns () / 1000);
 	printf ("Boot complete.\n");
 
 	/* Run actions specified on kernel command line. */
@@ -165,6 +175,11 @@ paging_init (uint64_t mem_end) {
 
 	// reload cr3
 	pml4_activate(0);
+
+	/* Make the kernel honor read-only pages too, so that a
+	   copy_to_user() into a read-only user page faults instead of
+	   quietly writing it. */
+	lcr0 (rcr0 () | CR0_WP);
 }
 
 /* Breaks the kernel command line into words and returns them as
@@ -221,6 +236,20 @@ parse_options (char **argv) {
 			random_init (atoi (value));
 		else if (!strcmp (name, "-mlfqs"))
 			thread_mlfqs = true;
+		else if (!strcmp (name, "-cfs"))
+			thread_cfs = true;
+		else if (!strcmp (name, "-cfs-latency"))
+			cfs_latency = atoi (value);
+		else if (!strcmp (name, "-cfs-granularity"))
+			cfs_min_granularity = atoi (value);
+		else if (!strcmp (name, "-tickless"))
+			timer_tickless = true;
+		else if (!strcmp (name, "-loops-per-tick"))
+			timer_loops_per_tick = atoi (value);
+		else if (!strcmp (name, "-pic"))
+			intr_force_pic = true;
+		else if (!strcmp (name, "-intr-off-trace"))
+			intr_off_trace = true;
 #ifdef USERPROG
 		else if (!strcmp (name, "-ul"))
 			user_page_limit = atoi (value);
@@ -231,6 +260,11 @@ parse_options (char **argv) {
 			PANIC ("unknown option `%s' (use -h for help)", name);
 	}
 
+	if (thread_mlfqs && thread_cfs)
+		PANIC ("-mlfqs and -cfs cannot be used together");
+	if (cfs_min_granularity < 1 || cfs_latency < cfs_min_granularity)
+		PANIC ("need 1 <= -cfs-granularity <= -cfs-latency");
+
 	return argv;
 }
 
@@ -326,6 +360,13 @@ usage (void) {
 			"  -f                 Format file system disk during startup.\n"
 			"  -rs=SEED           Set random number seed to SEED.\n"
 			"  -mlfqs             Use multi-level feedback queue scheduler.\n"
+			"  -cfs               Use completely fair scheduler.\n"
+			"  -cfs-latency=N     CFS target latency, in timer ticks (default 8).\n"
+			"  -cfs-granularity=N CFS minimum slice, in timer ticks (default 1).\n"
+			"  -tickless          Stop the periodic timer tick while idle.\n"
+			"  -loops-per-tick=N  Skip delay loop calibration, using N.\n"
+			"  -pic               Route device interrupts through the 8259A PICs.\n"
+			"  -intr-off-trace    Report where interrupts stay off longest.\n"
 #ifdef USERPROG
 			"  -ul=COUNT          Limit user memory to COUNT pages.\n"
 #endif
@@ -354,6 +395,8 @@ static void
 print_stats (void) {
 	timer_print_stats ();
 	thread_print_stats ();
+	intr_print_stats ();
+	softirq_print_stats ();
 #ifdef FILESYS
 	disk_print_stats ();
 #endif
@@ -361,5 +404,6 @@ print_stats (void) {
 	kbd_print_stats ();
 #ifdef USERPROG
 	exception_print_stats ();
+	syscall_print_stats ();
 #endif
 }
@@ -3,12 +3,16 @@
 #include <inttypes.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 #include "threads/flags.h"
 #include "threads/intr-stubs.h"
 #include "threads/io.h"
 #include "threads/thread.h"
 #include "threads/mmu.h"
+#include "threads/softirq.h"
 #include "threads/vaddr.h"
+#include "devices/ioapic.h"
+#include "devices/lapic.h"
 #include "devices/timer.h"
 #include "intrinsic.h"
 #ifdef USERPROG
@@ -93,18 +97,80 @@ static intr_handler_func *intr_handlers[INTR_CNT];
 /* Names for each interrupt, for debugging purposes. */
 static const char *intr_names[INTR_CNT];
 
+/* Time spent in each interrupt's handler, by the vector it was
+   registered under.  The name field is filled in on the way out,
+   by intr_get_stat().  Handlers that run with interrupts on may
+   be preempted or interrupted, and that time counts too. */
+static struct intr_stat intr_stats[INTR_CNT];
+
 /* External interrupts are those generated by devices outside the
    CPU, such as the timer.  External interrupts run with
    interrupts turned off, so they never nest, nor are they ever
    pre-empted.  Handlers for external interrupts also may not
    sleep, although they may invoke intr_yield_on_return() to
    request that a new process be scheduled just before the
-   interrupt returns. */
+   interrupt returns.  Anything longer should be handed to
+   softirq_queue(), which runs it after the PIC has been
+   acknowledged, with interrupts back on. */
 static bool in_external_intr;   /* Are we processing an external interrupt? */
 static bool yield_on_return;    /* Should we yield on interrupt return? */
 
+/* Interrupts-off accounting.  INTR_OFF_START is the TSC value at
+   which interrupts were last turned off, or 0 if that moment was
+   not seen (for example, on entry through the syscall
+   instruction).  INTR_OFF_MAX is the longest window measured so
+   far, in TSC cycles, and INTR_OFF_MAX_RIP is the code that
+   turned interrupts off at its start. */
+static uint64_t intr_off_start;
+static uintptr_t intr_off_rip;
+static uint64_t intr_off_max;
+static uintptr_t intr_off_max_rip;
+
+/* Interrupts-off tracer.  If true, every window is also counted
+   in a log2 histogram of its length, and the worst ones are kept
+   with the call stack that opened them, one per caller of
+   intr_disable().  Controlled by kernel command-line option
+   "-intr-off-trace". */
+bool intr_off_trace;
+
+#define INTR_OFF_BT_DEPTH 6             /* Return addresses per window. */
+#define INTR_OFF_WORST_CNT 8            /* Worst windows kept. */
+
+/* A traced interrupts-off window. */
+struct intr_off_sample {
+	uint64_t cycles;                    /* Length, in TSC cycles. */
+	uintptr_t bt[INTR_OFF_BT_DEPTH];    /* bt[0] turned interrupts off. */
+};
+
+static uintptr_t intr_off_bt[INTR_OFF_BT_DEPTH]; /* Current window. */
+static struct intr_off_sample intr_off_worst[INTR_OFF_WORST_CNT];
+static uint64_t intr_off_floor;         /* Shortest in a full INTR_OFF_WORST. */
+static uint64_t intr_off_hist[64];      /* [N]: lengths in [2**N, 2**(N+1)). */
+static uint64_t intr_off_cnt;           /* Windows traced. */
+
+static void intr_off_begin (uintptr_t rip, void **fp);
+static void intr_off_record (uint64_t len);
+static void intr_account (uint8_t vec, uint64_t cycles);
+
+/* Interrupt controller.  Device interrupts arrive through the I/O
+   and local APICs if the machine has them, and otherwise through
+   the 8259A PICs.  Either way drivers register and see the PIC
+   vectors 0x20...0x2f: in APIC mode each IRQ is raised on a
+   vector of its priority class (see irq_apic_vector()) and
+   intr_handler() translates it back through APIC_ISA_VEC.
+
+   If true, the PICs are used even when there are APICs.
+   Controlled by kernel command-line option "-pic". */
+bool intr_force_pic;
+
+#define APIC_VEC_MIN 0xc0               /* Lowest vector an APIC raises. */
+
+static bool use_apic;                   /* Routing through the APICs? */
+static uint8_t apic_isa_vec[INTR_CNT];  /* APIC vector -> PIC vector, or 0. */
+
 /* Programmable Interrupt Controller helpers. */
 static void pic_init (void);
+static void pic_disable (void);
 static void pic_end_of_interrupt (int irq);
 
 /* Interrupt handlers. */
@@ -135,7 +201,13 @@ intr_set_level (enum intr_level level) {
 enum intr_level
 intr_enable (void) {
 	enum intr_level old_level = intr_get_level ();
-	ASSERT (!intr_context ());
+
+	/* Softirq handlers run in interrupt context but may turn
+	   interrupts on; hardware interrupt handlers may not. */
+	ASSERT (!in_external_intr);
+
+	if (old_level == INTR_OFF)
+		intr_off_end ();
 
 	/* Enable interrupts by setting the interrupt flag.
 
@@ -156,16 +228,188 @@ intr_disable (void) {
 	   Hardware Interrupts". */
 	asm volatile ("cli" : : : "memory");
 
+	if (old_level == INTR_ON) {
+		void **fp = __builtin_frame_address (0);
+		intr_off_begin ((uintptr_t) fp[1], fp[0]);
+	}
+
 	return old_level;
 }
 
+/* Notes that interrupts just went off, turned off by the code at
+   RIP, whose caller's frame is FP.  When tracing, the frames are
+   followed as far as they stay on this kernel stack. */
+static void
+intr_off_begin (uintptr_t rip, void **fp) {
+	intr_off_start = rdtsc ();
+	intr_off_rip = rip;
+
+	if (intr_off_trace) {
+		void *stack = pg_round_down (__builtin_frame_address (0));
+		int depth = 0;
+
+		intr_off_bt[depth++] = rip;
+		for (; depth < INTR_OFF_BT_DEPTH; fp = fp[0]) {
+			if (pg_round_down (fp) != stack || fp[1] == NULL)
+				break;
+			intr_off_bt[depth++] = (uintptr_t) fp[1];
+		}
+		while (depth < INTR_OFF_BT_DEPTH)
+			intr_off_bt[depth++] = 0;
+	}
+}
+
+/* Notes that interrupts are about to come back on, closing the
+   current interrupts-off window.  intr_enable() calls this itself;
+   code that turns interrupts on by other means, such as an iretq
+   to a context with interrupts on, must call it first.
+   Interrupts must be off. */
+void
+intr_off_end (void) {
+	uint64_t len;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (intr_off_start == 0)
+		return;
+	len = rdtsc () - intr_off_start;
+	intr_off_start = 0;
+	if (len > intr_off_max) {
+		intr_off_max = len;
+		intr_off_max_rip = intr_off_rip;
+	}
+	if (intr_off_trace)
+		intr_off_record (len);
+}
+
+/* Adds a window of LEN cycles, opened at intr_off_bt, to the
+   histogram and, if it is among the worst, to INTR_OFF_WORST.
+   Each caller of intr_disable() keeps at most one entry there,
+   its longest, so one hot spot cannot crowd out the rest. */
+static void
+intr_off_record (uint64_t len) {
+	struct intr_off_sample *s, *victim;
+	uint64_t floor;
+
+	intr_off_cnt++;
+	intr_off_hist[len != 0 ? 63 - __builtin_clzll (len) : 0]++;
+	if (len <= intr_off_floor)
+		return;
+
+	victim = NULL;
+	for (s = intr_off_worst; s < intr_off_worst + INTR_OFF_WORST_CNT; s++)
+		if (s->bt[0] == intr_off_bt[0]) {
+			victim = s;
+			break;
+		} else if (victim == NULL || s->cycles < victim->cycles)
+			victim = s;
+	if (len <= victim->cycles)
+		return;
+	victim->cycles = len;
+	memcpy (victim->bt, intr_off_bt, sizeof victim->bt);
+
+	floor = UINT64_MAX;
+	for (s = intr_off_worst; s < intr_off_worst + INTR_OFF_WORST_CNT; s++)
+		if (s->cycles < floor)
+			floor = s->cycles;
+	intr_off_floor = floor;
+}
+
+/* Returns the longest interrupts-off window seen so far, in TSC
+   cycles. */
+uint64_t
+intr_off_max_cycles (void) {
+	return intr_off_max;
+}
+
+/* Charges CYCLES to the handler for interrupt VEC. */
+static void
+intr_account (uint8_t vec, uint64_t cycles) {
+	struct intr_stat *s = &intr_stats[vec];
+	int bucket = cycles != 0 ? 63 - __builtin_clzll (cycles) : 0;
+
+	s->count++;
+	s->cycles += cycles;
+	if (cycles > s->max_cycles)
+		s->max_cycles = cycles;
+	s->hist[bucket < INTR_STAT_HIST_CNT ? bucket : INTR_STAT_HIST_CNT - 1]++;
+}
+
+/* Copies the accounting for interrupt VEC into *STAT. */
+void
+intr_get_stat (uint8_t vec, struct intr_stat *stat) {
+	enum intr_level old_level = intr_disable ();
+	*stat = intr_stats[vec];
+	intr_set_level (old_level);
+	strlcpy (stat->name, intr_names[vec], sizeof stat->name);
+}
+
+/* Prints interrupt statistics: time spent in each handler that
+   ran, then the tracer's findings if it was on. */
+void
+intr_print_stats (void) {
+	struct intr_off_sample worst[INTR_OFF_WORST_CNT];
+	int i, j;
+
+	for (i = 0; i < INTR_CNT; i++) {
+		const struct intr_stat *s = &intr_stats[i];
+
+		if (s->count == 0)
+			continue;
+		printf ("Interrupt %#04x (%s): %'"PRIu64" times, %'"PRIu64" cycles "
+				"average, %'"PRIu64" max\n", i, intr_names[i], s->count,
+				s->cycles / s->count, s->max_cycles);
+		printf ("  log2 cycles:");
+		for (j = 0; j < INTR_STAT_HIST_CNT; j++)
+			if (s->hist[j] != 0)
+				printf (" %d:%"PRIu32, j, s->hist[j]);
+		printf ("\n");
+	}
+
+	printf ("Interrupts: longest interrupts-off window %"PRIu64" cycles, "
+			"starting at %#"PRIx64"\n", intr_off_max, (uint64_t) intr_off_max_rip);
+	if (!intr_off_trace)
+		return;
+
+	printf ("Interrupts-off windows: %'"PRIu64" traced\n", intr_off_cnt);
+	for (i = 0; i < 64; i++)
+		if (intr_off_hist[i] != 0)
+			printf ("  %'12"PRIu64" cycles (%'10"PRIu64" ns) and up: %'"PRIu64"\n",
+					(uint64_t) 1 << i, timer_tsc_to_ns ((uint64_t) 1 << i),
+					intr_off_hist[i]);
+
+	/* Longest first. */
+	memcpy (worst, intr_off_worst, sizeof worst);
+	for (i = 1; i < INTR_OFF_WORST_CNT; i++)
+		for (j = i; j > 0 && worst[j].cycles > worst[j - 1].cycles; j--) {
+			struct intr_off_sample tmp = worst[j];
+			worst[j] = worst[j - 1];
+			worst[j - 1] = tmp;
+		}
+	printf ("Worst interrupts-off windows, with call stacks:\n");
+	for (i = 0; i < INTR_OFF_WORST_CNT && worst[i].cycles != 0; i++) {
+		printf ("  %'"PRIu64" cycles (%'"PRIu64" ns):", worst[i].cycles,
+				timer_tsc_to_ns (worst[i].cycles));
+		for (j = 0; j < INTR_OFF_BT_DEPTH && worst[i].bt[j] != 0; j++)
+			printf (" %#"PRIx64, (uint64_t) worst[i].bt[j]);
+		printf ("\n");
+	}
+}
+
 /* Initializes the interrupt system. */
 void
 intr_init (void) {
 	int i;
 
-	/* Initialize interrupt controller. */
+	/* Initialize interrupt controller.  The local APIC is wanted
+	   for its timer even if the PICs deliver device interrupts. */
 	pic_init ();
+	if (lapic_init () && !intr_force_pic && ioapic_init ()) {
+		pic_disable ();
+		lapic_mask_extint ();
+		use_apic = true;
+	}
+	softirq_init ();
 
 	/* Initialize IDT. */
 	for (i = 0; i < INTR_CNT; i++) {
@@ -221,14 +465,49 @@ register_handler (uint8_t vec_no, int dpl, enum intr_level level,
 	intr_names[vec_no] = name;
 }
 
+/* Returns true if VEC_NO is an external interrupt: one of the
+   PICs' 0x20...0x2f or one raised by the APICs. */
+static bool
+is_external (uint64_t vec_no) {
+	return (vec_no >= 0x20 && vec_no <= 0x2f)
+		|| (vec_no >= APIC_VEC_MIN && vec_no != LAPIC_SPURIOUS_VEC);
+}
+
+/* Returns the vector the I/O APIC raises for ISA IRQ.  The upper
+   nibble of a vector is its priority class: the local APIC
+   delivers higher classes first.  Within a class the lower
+   nibble is the IRQ, so the vectors are distinct. */
+static uint8_t
+irq_apic_vector (int irq) {
+	switch (irq) {
+		case 0:
+			return INTR_CLASS_TIMER << 4;
+		case 14:
+		case 15:
+			return INTR_CLASS_DISK << 4 | irq;
+		default:
+			return INTR_CLASS_DEV << 4 | irq;
+	}
+}
+
 /* Registers external interrupt VEC_NO to invoke HANDLER, which
    is named NAME for debugging purposes.  The handler will
-   execute with interrupts disabled. */
+   execute with interrupts disabled.  VEC_NO 0x20...0x2f stands
+   for ISA IRQ 0...15 whichever controller delivers it. */
 void
 intr_register_ext (uint8_t vec_no, intr_handler_func *handler,
 		const char *name) {
-	ASSERT (vec_no >= 0x20 && vec_no <= 0x2f);
+	ASSERT (is_external (vec_no));
 	register_handler (vec_no, 0, INTR_OFF, handler, name);
+
+	if (use_apic && vec_no <= 0x2f) {
+		int irq = vec_no - 0x20;
+		uint8_t apic_vec = irq_apic_vector (irq);
+
+		apic_isa_vec[apic_vec] = vec_no;
+		if (!ioapic_route (irq, apic_vec, lapic_id ()))
+			PANIC ("IRQ %d is not wired to the I/O APIC", irq);
+	}
 }
 
 /* Registers internal interrupt VEC_NO to invoke HANDLER, which
@@ -248,15 +527,16 @@ void
 intr_register_int (uint8_t vec_no, int dpl, enum intr_level level,
 		intr_handler_func *handler, const char *name)
 {
-	ASSERT (vec_no < 0x20 || vec_no > 0x2f);
+	ASSERT (!is_external (vec_no));
 	register_handler (vec_no, dpl, level, handler, name);
 }
 
-/* Returns true during processing of an external interrupt
-   and false at all other times. */
+/* Returns true during processing of an external interrupt,
+   including the softirqs run on its way out, and false at all
+   other times. */
 bool
 intr_context (void) {
-	return in_external_intr;
+	return in_external_intr || softirq_context ();
 }
 
 /* During processing of an external interrupt, directs the
@@ -308,6 +588,15 @@ pic_init (void) {
 	outb (0xa1, 0x00);
 }
 
+/* Masks every IRQ on both PICs, once the I/O APIC has taken
+   over.  The PICs stay programmed, so a stray interrupt they
+   raise anyway lands on a vector we know. */
+static void
+pic_disable (void) {
+	outb (0x21, 0xff);
+	outb (0xa1, 0xff);
+}
+
 /* Sends an end-of-interrupt signal to the PIC for the given IRQ.
    If we don't acknowledge the IRQ, it will never be delivered to
    us again, so this is important.  */
@@ -330,27 +619,37 @@ pic_end_of_interrupt (int irq) {
    interrupted thread's registers. */
 void
 intr_handler (struct intr_frame *frame) {
+	uint8_t vec = frame->vec_no;        /* As raised by the hardware. */
 	bool external;
 	intr_handler_func *handler;
 
 	/* External interrupts are special.
 	   We only handle one at a time (so interrupts must be off)
-	   and they need to be acknowledged on the PIC (see below).
+	   and they need to be acknowledged on the PIC or the local
+	   APIC (see below).  Handlers see the PIC vector even if an
+	   APIC raised it.
 	   An external interrupt handler cannot sleep. */
-	external = frame->vec_no >= 0x20 && frame->vec_no < 0x30;
+	external = is_external (vec);
+	if (apic_isa_vec[vec] != 0)
+		frame->vec_no = apic_isa_vec[vec];
+	if ((frame->eflags & FLAG_IF) && intr_get_level () == INTR_OFF)
+		intr_off_begin (frame->rip, (void **) frame->R.rbp);
 	if (external) {
 		ASSERT (intr_get_level () == INTR_OFF);
-		ASSERT (!intr_context ());
+		ASSERT (!in_external_intr);
 
 		in_external_intr = true;
-		yield_on_return = false;
 	}
 
 	/* Invoke the interrupt's handler. */
 	handler = intr_handlers[frame->vec_no];
-	if (handler != NULL)
+	if (handler != NULL) {
+		uint8_t stat_vec = frame->vec_no;
+		uint64_t start = rdtsc ();
+
 		handler (frame);
-	else if (frame->vec_no == 0x27 || frame->vec_no == 0x2f) {
+		intr_account (stat_vec, rdtsc () - start);
+	} else if (vec == 0x27 || vec == 0x2f || vec == LAPIC_SPURIOUS_VEC) {
 		/* There is no handler, but this interrupt can trigger
 		   spuriously due to a hardware fault or hardware race
 		   condition.  Ignore it. */
@@ -367,11 +666,22 @@ intr_handler (struct intr_frame *frame) {
 		ASSERT (intr_context ());
 
 		in_external_intr = false;
-		pic_end_of_interrupt (frame->vec_no);
-
-		if (yield_on_return)
+		if (vec < APIC_VEC_MIN)
+			pic_end_of_interrupt (vec);
+		else
+			lapic_eoi ();
+
+		/* Run deferred work with interrupts on.  If we interrupted
+		   that work, it is still going on below us, so leave any
+		   yield to the interrupt that started it. */
+		softirq_run ();
+		if (yield_on_return && !softirq_context ()) {
+			yield_on_return = false;
 			thread_yield ();
+		}
 	}
+	if ((frame->eflags & FLAG_IF) && intr_get_level () == INTR_OFF)
+		intr_off_end ();
 }
 
 /* Dumps interrupt frame F to the console, for debugging. */
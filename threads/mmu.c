@@ -206,6 +206,31 @@ pml4_activate (uint64_t *pml4) {
 	lcr3 (vtop (pml4 ? pml4 : base_pml4));
 }
 
+/* Maps physical range [PADDR, PADDR + SIZE) into the kernel's
+ * physical memory window, at ptov (PADDR), in base_pml4 and so in
+ * every page table.  paging_init() only maps RAM; this reaches
+ * device registers and firmware tables beyond it.  Pages already
+ * mapped are left alone unless UNCACHED, which device registers
+ * need.  Returns ptov (PADDR), or a null pointer if a page table
+ * could not be allocated. */
+void *
+pml4_map_phys (uint64_t paddr, size_t size, bool uncached) {
+	uint64_t pa;
+
+	for (pa = (uint64_t) pg_round_down (paddr); pa < paddr + size; pa += PGSIZE) {
+		uint64_t va = (uint64_t) ptov (pa);
+		uint64_t *pte = pml4e_walk (base_pml4, va, 1);
+
+		if (pte == NULL)
+			return NULL;
+		if (uncached || !(*pte & PTE_P)) {
+			*pte = pa | PTE_P | PTE_W | (uncached ? PTE_PWT | PTE_PCD : 0);
+			invlpg (va);
+		}
+	}
+	return ptov (paddr);
+}
+
 /* Looks up the physical address that corresponds to user virtual
  * address UADDR in pml4.  Returns the kernel virtual address
  * corresponding to that physical address, or a null pointer if
@@ -262,6 +287,50 @@ pml4_clear_page (uint64_t *pml4, void *upage) {
 	}
 }
 
+/* Gives PML4 a private, writable copy of the copy-on-write page
+ * (PTE_COW) containing user virtual address UADDR.  The last
+ * sharer of a frame just gets write access back; the others copy
+ * it to a new user page and drop their reference.  Returns false
+ * if the page is not copy-on-write or no page is free. */
+bool
+pml4_break_cow (uint64_t *pml4, const void *uaddr) {
+	uint64_t *pte;
+	void *kpage, *copy;
+
+	ASSERT (is_user_vaddr (uaddr));
+
+	pte = pml4e_walk (pml4, (uint64_t) uaddr, false);
+	if (pte == NULL || (*pte & (PTE_P | PTE_COW)) != (PTE_P | PTE_COW))
+		return false;
+
+	kpage = ptov (PTE_ADDR (*pte));
+	if (palloc_page_refcnt (kpage) > 1) {
+		copy = palloc_get_page (PAL_USER);
+		if (copy == NULL)
+			return false;
+		memcpy (copy, kpage, PGSIZE);
+		*pte = vtop (copy) | (*pte & PTE_FLAGS);
+		palloc_free_page (kpage);
+	}
+	*pte = (*pte | PTE_W) & ~PTE_COW;
+
+	if (rcr3 () == vtop (pml4))
+		invlpg ((uint64_t) pg_round_down (uaddr));
+	return true;
+}
+
+/* Handles a page fault at ADDR under PML4, which may be null,
+ * if it is a write to a copy-on-write user page, by the process
+ * or by a copy_to_user() on its behalf.  WRITE and NOT_PRESENT
+ * come from the fault's error code.  Returns true if the page is
+ * now writable and the faulting access can be retried. */
+bool
+pml4_cow_fault (uint64_t *pml4, const void *addr, bool write,
+		bool not_present) {
+	return write && !not_present && pml4 != NULL && is_user_vaddr (addr)
+		&& pml4_break_cow (pml4, addr);
+}
+
 /* Returns true if the PTE for virtual page VPAGE in PML4 is dirty,
  * that is, if the page has been modified since the PTE was
  * installed.
@@ -30,6 +30,7 @@
 struct pool {
 	struct lock lock;               /* Mutual exclusion. */
 	struct bitmap *used_map;        /* Bitmap of free pages. */
+	uint16_t *sharers;              /* Extra references to each page. */
 	uint8_t *base;                  /* Base of pool. */
 };
 
@@ -42,6 +43,7 @@ static void
 init_pool (struct pool *p, void **bm_base, uint64_t start, uint64_t end);
 
 static bool page_from_pool (const struct pool *, void *page);
+static uint16_t *page_sharers (void *page);
 
 /* multiboot info */
 struct multiboot_info {
@@ -191,6 +193,8 @@ populate_pools (struct area *base_mem, struct area *ext_mem) {
 	init_pool(&user_pool, &free_start, region_start, end);
 
 	// Iterate over the e820_entry. Setup the usable.
+	// ACPI_RECLAIMABLE pages stay allocated: the ACPI tables in them
+	// are read after palloc_init() (see madt_find() in ioapic.c).
 	uint64_t usable_bound = (uint64_t) free_start;
 	struct pool *pool;
 	void *pool_end;
@@ -198,7 +202,7 @@ populate_pools (struct area *base_mem, struct area *ext_mem) {
 
 	for (i = 0; i < mb_info->mmap_len / sizeof (struct e820_entry); i++) {
 		struct e820_entry *entry = &entries[i];
-		if (entry->type == ACPI_RECLAIMABLE || entry->type == USABLE) {
+		if (entry->type == USABLE) {
 			uint64_t start = (uint64_t)
 				ptov (APPEND_HILO (entry->mem_hi, entry->mem_lo));
 			uint64_t size = APPEND_HILO (entry->len_hi, entry->len_lo);
@@ -322,12 +326,40 @@ palloc_free_multiple (void *pages, size_t page_cnt) {
 	bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
 }
 
-/* Frees the page at PAGE. */
+/* Frees the page at PAGE.  If other references to it were taken
+   with palloc_page_ref(), drops one of them instead. */
 void
 palloc_free_page (void *page) {
+	uint16_t *sharers = page != NULL ? page_sharers (page) : NULL;
+	uint16_t cnt = sharers != NULL ? __atomic_load_n (sharers, __ATOMIC_ACQUIRE) : 0;
+
+	while (cnt > 0)
+		if (__atomic_compare_exchange_n (sharers, &cnt, cnt - 1, false,
+					__ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+			return;
 	palloc_free_multiple (page, 1);
 }
 
+/* Takes another reference to PAGE, which must be allocated, so
+   that it can be mapped in more than one place (for instance, by
+   fork's copy-on-write sharing).  Each reference is dropped with
+   palloc_free_page(); the page is freed with the last. */
+void
+palloc_page_ref (void *page) {
+	uint16_t *sharers = page_sharers (page);
+
+	ASSERT (pg_ofs (page) == 0);
+	ASSERT (sharers != NULL && *sharers < UINT16_MAX);
+	__atomic_fetch_add (sharers, 1, __ATOMIC_RELAXED);
+}
+
+/* Returns the number of references to PAGE: 1 unless
+   palloc_page_ref() has been used on it. */
+unsigned
+palloc_page_refcnt (void *page) {
+	return __atomic_load_n (page_sharers (page), __ATOMIC_ACQUIRE) + 1;
+}
+
 /* Initializes pool P as starting at START and ending at END */
 static void
 init_pool (struct pool *p, void **bm_base, uint64_t start, uint64_t end) {
@@ -336,6 +368,7 @@ init_pool (struct pool *p, void **bm_base, uint64_t start, uint64_t end) {
      and subtract it from the pool's size. */
 	uint64_t pgcnt = (end - start) / PGSIZE;
 	size_t bm_pages = DIV_ROUND_UP (bitmap_buf_size (pgcnt), PGSIZE) * PGSIZE;
+	size_t sharer_pages = ROUND_UP (pgcnt * sizeof *p->sharers, PGSIZE);
 
 	lock_init(&p->lock);
 	p->used_map = bitmap_create_in_buf (pgcnt, *bm_base, bm_pages);
@@ -345,6 +378,11 @@ init_pool (struct pool *p, void **bm_base, uint64_t start, uint64_t end) {
 	bitmap_set_all(p->used_map, true);
 
 	*bm_base += bm_pages;
+
+	// Per-page reference counts follow the bitmap.
+	p->sharers = *bm_base;
+	memset (p->sharers, 0, sharer_pages);
+	*bm_base += sharer_pages;
 }
 
 /* Returns true if PAGE was allocated from POOL,
@@ -356,3 +394,18 @@ page_from_pool (const struct pool *pool, void *page) {
 	size_t end_page = start_page + bitmap_size (pool->used_map);
 	return page_no >= start_page && page_no < end_page;
 }
+
+/* Returns the extra-reference count of PAGE, or a null pointer if
+   PAGE belongs to neither pool. */
+static uint16_t *
+page_sharers (void *page) {
+	struct pool *pool;
+
+	if (page_from_pool (&user_pool, page))
+		pool = &user_pool;
+	else if (page_from_pool (&kernel_pool, page))
+		pool = &kernel_pool;
+	else
+		return NULL;
+	return &pool->sharers[pg_no (page) - pg_no (pool->base)];
+}
@@ -0,0 +1,180 @@
+#include "threads/softirq.h"
+#include <debug.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* Most work items run on one interrupt's way out.  Whatever is
+   still queued after that many is handed to softirqd. */
+#define SOFTIRQ_BUDGET 16
+
+/* Queued work, one FIFO list per priority.  Interrupts must be
+   off to touch the lists. */
+static struct list softirq_queues[SOFTIRQ_PRI_CNT];
+static int softirq_pending;         /* # of items in all queues. */
+
+/* Work runs in one place at a time: either on the way out of an
+   external interrupt (SOFTIRQ_IN_INTR) or in softirqd.  While
+   either is busy, interrupts that arrive leave their work queued
+   for it. */
+static bool softirq_busy;
+static bool softirq_in_intr;
+
+/* Worker thread for work that did not fit in an interrupt's
+   budget.  NULL until softirq_start(). */
+static struct thread *softirqd;
+static bool softirqd_idle;          /* Blocked waiting for work? */
+
+/* Statistics. */
+static int64_t softirq_runs[SOFTIRQ_PRI_CNT];  /* Items run, by priority. */
+static int64_t softirqd_wakeups;               /* Times softirqd took over. */
+
+static bool softirq_process (int budget);
+static void softirqd_main (void *aux);
+
+/* Initializes the softirq queues.  Called by intr_init(). */
+void
+softirq_init (void) {
+	for (int i = 0; i < SOFTIRQ_PRI_CNT; i++)
+		list_init (&softirq_queues[i]);
+}
+
+/* Initializes W to run FUNC(AUX) when queued. */
+void
+softirq_work_init (struct softirq_work *w, softirq_func *func, void *aux) {
+	ASSERT (w != NULL);
+	ASSERT (func != NULL);
+
+	w->func = func;
+	w->aux = aux;
+	w->queued = false;
+}
+
+/* Queues W to run at priority PRI, unless it is already queued.
+   May be called from an interrupt handler. */
+void
+softirq_queue (struct softirq_work *w, enum softirq_priority pri) {
+	enum intr_level old_level;
+
+	ASSERT (pri < SOFTIRQ_PRI_CNT);
+
+	old_level = intr_disable ();
+	if (!w->queued) {
+		w->queued = true;
+		list_push_back (&softirq_queues[pri], &w->elem);
+		softirq_pending++;
+	}
+	intr_set_level (old_level);
+}
+
+/* Starts the softirqd thread.  Until then, work that does not fit
+   in one interrupt's budget waits for the next interrupt. */
+void
+softirq_start (void) {
+	struct semaphore started;
+
+	sema_init (&started, 0);
+	thread_create ("softirqd", PRI_MAX, softirqd_main, &started);
+	sema_down (&started);
+}
+
+/* Runs queued work on the way out of an external interrupt, after
+   the PIC has been acknowledged.  Called by intr_handler() with
+   interrupts off; returns with interrupts off. */
+void
+softirq_run (void) {
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (softirq_pending == 0 || softirq_busy)
+		return;
+
+	softirq_busy = softirq_in_intr = true;
+	if (!softirq_process (SOFTIRQ_BUDGET) && softirqd_idle) {
+		softirqd_idle = false;
+		thread_unblock (softirqd);
+		intr_yield_on_return ();
+	}
+	softirq_busy = softirq_in_intr = false;
+}
+
+/* Returns true while queued work is running on the way out of an
+   external interrupt. */
+bool
+softirq_context (void) {
+	return softirq_in_intr;
+}
+
+/* Returns softirqd, or a null pointer before softirq_start(). */
+struct thread *
+softirq_thread (void) {
+	return softirqd;
+}
+
+/* Prints softirq statistics. */
+void
+softirq_print_stats (void) {
+	printf ("Softirq: %"PRId64" hi, %"PRId64" block, %"PRId64" lo items run, "
+			"softirqd woken %"PRId64" times\n",
+			softirq_runs[SOFTIRQ_HI], softirq_runs[SOFTIRQ_BLOCK],
+			softirq_runs[SOFTIRQ_LO], softirqd_wakeups);
+}
+
+/* Runs up to BUDGET queued items, highest priority first, each
+   with interrupts on.  Returns true if the queues are empty.
+   Interrupts must be off, and SOFTIRQ_BUSY must be set. */
+static bool
+softirq_process (int budget) {
+	ASSERT (intr_get_level () == INTR_OFF);
+	ASSERT (softirq_busy);
+
+	while (softirq_pending > 0 && budget-- > 0) {
+		struct softirq_work *w = NULL;
+		int pri;
+
+		for (pri = 0; pri < SOFTIRQ_PRI_CNT; pri++)
+			if (!list_empty (&softirq_queues[pri])) {
+				w = list_entry (list_pop_front (&softirq_queues[pri]),
+						struct softirq_work, elem);
+				break;
+			}
+		ASSERT (w != NULL);
+		w->queued = false;
+		softirq_pending--;
+		softirq_runs[pri]++;
+
+		intr_enable ();
+		w->func (w->aux);
+		intr_disable ();
+	}
+	return softirq_pending == 0;
+}
+
+/* softirqd: runs the work that interrupts left over. */
+static void
+softirqd_main (void *started_) {
+	struct semaphore *started = started_;
+
+	softirqd = thread_current ();
+	sema_up (started);
+
+	intr_disable ();
+	for (;;) {
+		if (softirq_pending == 0 || softirq_busy) {
+			softirqd_idle = true;
+			thread_block ();
+			continue;
+		}
+
+		softirq_busy = true;
+		softirqd_wakeups++;
+		while (!softirq_process (SOFTIRQ_BUDGET)) {
+			/* Give other threads of our priority a turn. */
+			softirq_busy = false;
+			thread_yield ();
+			softirq_busy = true;
+		}
+		softirq_busy = false;
+	}
+}
@@ -33,6 +33,16 @@
 #include "threads/interrupt.h"
 #include "threads/thread.h"
 
+static void sema_wait (struct semaphore *, struct lock *);
+static void rwlock_wait (struct rwlock *, struct rb_tree *);
+static void rwlock_grant (struct rwlock *, struct thread *, bool write);
+static void rwlock_drop (struct rwlock *);
+static void rwlock_hand_off (struct rwlock *);
+static bool waiter_less (const struct rb_elem *, const struct rb_elem *,
+		void *);
+static bool cond_waiter_less (const struct rb_elem *,
+		const struct rb_elem *, void *);
+
 
 void list_insert (struct list_elem *, struct list_elem *);
 /* Initializes semaphore SEMA to VALUE.  A semaphore is a
@@ -49,7 +59,7 @@ sema_init (struct semaphore *sema, unsigned value) {
 	ASSERT (sema != NULL);
 
 	sema->value = value;
-	list_init (&sema->waiters);
+	rb_init (&sema->waiters, waiter_less, NULL);
 }
 
 /* Down or "P" operation on a semaphore.  Waits for SEMA's value
@@ -68,12 +78,31 @@ sema_down (struct semaphore *sema) {//sema get
 	ASSERT (!intr_context ());
 
 	old_level = intr_disable ();
+	sema_wait (sema, NULL);
+	intr_set_level (old_level);
+}
+
+/* Waits for SEMA's value to become positive and decrements it,
+   for sema_down() or, when LOCK is non-null, lock_acquire().  In
+   the latter case, once the current thread is in SEMA's waiter
+   tree it donates its priority to LOCK's holder.  Interrupts
+   must be off. */
+static void
+sema_wait (struct semaphore *sema, struct lock *lock) {
+	struct thread *cur = thread_current ();
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
 	while (sema->value == 0) {
-		list_insert_ordered(&sema->waiters, &thread_current()->elem, thread_compare_priority, 0);
+		rb_insert (&sema->waiters, &cur->wait_elem);
+		cur->wait_queue = &sema->waiters;
+		if (lock != NULL) {
+			cur->wait_on_lock = lock;
+			thread_refresh_priority (lock->holder);
+		}
 		thread_block ();
 	}
 	sema->value--;
-	intr_set_level (old_level);
 }
 
 /* Down or "P" operation on a semaphore, but only if the
@@ -112,11 +141,13 @@ sema_up (struct semaphore *sema) {//sema unlock
 	ASSERT (sema != NULL);
 
 	old_level = intr_disable ();
-	if (!list_empty (&sema->waiters)) {//스레드 언락하기
-		//꺼내기 전에 다시 정렬. donate로 인한 우선순위 변동 있을 수 있음
-		list_sort(&sema->waiters, thread_compare_priority, 0);
-		thread_unblock (list_entry (list_pop_front (&sema->waiters),
-					struct thread, elem));
+	if (!rb_empty (&sema->waiters)) {//스레드 언락하기
+		//donate로 인한 우선순위 변동은 synch_requeue()가 이미 반영함
+		struct thread *t = rb_entry (rb_min (&sema->waiters),
+				struct thread, wait_elem);
+		rb_remove (&sema->waiters, &t->wait_elem);
+		t->wait_queue = NULL;
+		thread_unblock (t);
 	}
 	sema->value++;
 	check_preemption(); //unblock 호출되며 ready_list가 수정되므로 선점 여부 확인
@@ -197,28 +228,21 @@ lock_acquire (struct lock *lock) {
 	ASSERT (!lock_held_by_current_thread (lock));
 
 	struct thread *cur = thread_current();
-	//해당 lock 의 holder 가 존재한다면
-	//현재 스레드의 wait_on_lock 변수에 획득 하기를 기다리는 lock의 주소를 저장
-	//multiple donation을 고려하기 위해 이전 상태의 우선순위 기억,
-	//donation을 받은 스레드의 thread 구조체를 list로 관리한다
-	//list_push_back(&lock->holder->donations, &t->donation_elem);
-	if (lock->holder != NULL) {
-		cur->wait_on_lock = lock;
-		list_insert_ordered (&lock->holder->donations, &cur->donation_elem, thread_compare_priority, 0);
-		if (!thread_mlfqs)
-			donate_priority();
-	}
+	enum intr_level old_level;
 
-	//priority donation을 고려하기 위해 donate_priority()함수 호출
-	
-	sema_down (&lock->semaphore);
-	//lock->holder = thread_current ();
+	//기다리는 동안 holder에게 priority를 기부한다 (sema_wait)
+	old_level = intr_disable ();
+	sema_wait (&lock->semaphore, lock);
 	cur->wait_on_lock = NULL;
 
-	//lock 을 획득 한 후 lock holder를 갱신
-	lock->holder = thread_current();
-
+	//lock 을 획득 한 후 lock holder를 갱신하고,
+	//아직 기다리는 스레드들의 priority를 물려받는다
+	lock->holder = cur;
+	list_push_back (&cur->held_locks, &lock->elem);
+	thread_refresh_priority (cur);
+	intr_set_level (old_level);
 }
+
 /* Tries to acquires LOCK and returns true if successful or false
    on failure.  The lock must not already be held by the current
    thread.
@@ -231,14 +255,19 @@ lock_acquire (struct lock *lock) {
    이 함수는 잠들지 않기 때문에 인터럽트 핸들러에서도 호출할 수 있다. */
 bool
 lock_try_acquire (struct lock *lock) {
+	enum intr_level old_level;
 	bool success;
 
 	ASSERT (lock != NULL);
 	ASSERT (!lock_held_by_current_thread (lock));
 
+	old_level = intr_disable ();
 	success = sema_try_down (&lock->semaphore);
-	if (success)
+	if (success) {
 		lock->holder = thread_current ();
+		list_push_back (&lock->holder->held_locks, &lock->elem);
+	}
+	intr_set_level (old_level);
 	return success;
 }
 
@@ -251,21 +280,18 @@ lock_try_acquire (struct lock *lock) {
    락을 해제한다. 락을 해제할 수 있는 것은 락을 보유한 현재 스레드이다 */
 void
 lock_release (struct lock *lock) {
+	enum intr_level old_level;
+
 	ASSERT (lock != NULL);
 	ASSERT (lock_held_by_current_thread (lock));
 
-    lock->holder = NULL;
-	if(!thread_mlfqs) {
-		remove_with_lock(lock);
-		refresh_priority();
-	}
-	sema_up(&lock->semaphore);
-
-	//priority 를 빌려준 스레드들을 donation 리스트에서 제거하고, priority 재설정
-	// reomve with lock 함수 추가
-	//remove_with_lock(lock);
-	// refresh priority 추가
-	//refresh_priority();
+	//이 lock으로 받던 donation을 내려놓는다: O(보유한 lock 수)
+	old_level = intr_disable ();
+	lock->holder = NULL;
+	list_remove (&lock->elem);
+	thread_refresh_priority (thread_current ());
+	sema_up (&lock->semaphore);
+	intr_set_level (old_level);
 }
 
 /* Returns true if the current thread holds LOK, false
@@ -279,10 +305,11 @@ lock_held_by_current_thread (const struct lock *lock) {
 	return lock->holder == thread_current ();
 }
 
-/* One semaphore in a list. */
+/* One semaphore in a condition's waiter tree. */
 struct semaphore_elem {
-	struct list_elem elem;              /* List element. */
+	struct rb_elem elem;                /* Tree element. */
 	struct semaphore semaphore;         /* This semaphore. */
+	struct thread *thread;              /* Thread waiting on it. */
 };
 
 /* Initializes condition variable COND.  A condition variable
@@ -292,7 +319,7 @@ void
 cond_init (struct condition *cond) {
 	ASSERT (cond != NULL);
 
-	list_init (&cond->waiters);
+	rb_init (&cond->waiters, cond_waiter_less, NULL);
 }
 
 /* Atomically releases LOCK and waits for COND to be signaled by
@@ -318,6 +345,7 @@ cond_init (struct condition *cond) {
 void
 cond_wait (struct condition *cond, struct lock *lock) {
 	struct semaphore_elem waiter;
+	enum intr_level old_level;
 
 	ASSERT (cond != NULL);
 	ASSERT (lock != NULL);
@@ -325,37 +353,17 @@ cond_wait (struct condition *cond, struct lock *lock) {
 	ASSERT (lock_held_by_current_thread (lock));
 
 	sema_init (&waiter.semaphore, 0);
-	list_insert_ordered(&cond->waiters, &waiter.elem, sema_priority, 0);
+	waiter.thread = thread_current ();
+	old_level = intr_disable ();
+	rb_insert (&cond->waiters, &waiter.elem);
+	waiter.thread->wait_cond = cond;
+	waiter.thread->wait_cond_elem = &waiter.elem;
+	intr_set_level (old_level);
 	lock_release (lock);
 	sema_down (&waiter.semaphore);
 	lock_acquire (lock);
 }
 
-bool sema_priority(const struct list_elem *a, const struct list_elem *b, void *aux UNUSED) {
-	struct semaphore_elem *sema_a = list_entry(a, struct semaphore_elem, elem);
-	struct semaphore_elem *sema_b = list_entry(b, struct semaphore_elem, elem);
-
-	struct list *waiters_a = &(sema_a->semaphore.waiters);
-	struct list *waiters_b = &(sema_b->semaphore.waiters);
-
-	    // 리스트가 비어있는지 확인합니다.
-    if (list_empty(waiters_a)) {
-        return false; // a의 대기 리스트가 비어있다면, b가 우선입니다.
-    }
-    if (list_empty(waiters_b)) {
-        return true; // b의 대기 리스트가 비어있다면, a가 우선입니다.
-    }
-
-
-	struct thread *thread_a = list_entry(list_begin(waiters_a), struct thread, elem);
-	struct thread *thread_b = list_entry(list_begin(waiters_b), struct thread, elem);
-
-	return thread_a->priority > thread_b->priority;
-}
-
-
-
-
 /* If any threads are waiting on COND (protected by LOCK), then
    this function signals one of them to wake up from its wait.
    LOCK must be held before calling this function.
@@ -365,16 +373,22 @@ bool sema_priority(const struct list_elem *a, const struct list_elem *b, void *a
    interrupt handler. */
 void
 cond_signal (struct condition *cond, struct lock *lock UNUSED) {
+	enum intr_level old_level;
+
 	ASSERT (cond != NULL);
 	ASSERT (lock != NULL);
 	ASSERT (!intr_context ());
 	ASSERT (lock_held_by_current_thread (lock));
 
-	if (!list_empty (&cond->waiters)) {
-		list_sort(&cond->waiters, sema_priority, 0);
-		sema_up (&list_entry (list_pop_front (&cond->waiters),
-					struct semaphore_elem, elem)->semaphore);
+	old_level = intr_disable ();
+	if (!rb_empty (&cond->waiters)) {
+		struct semaphore_elem *waiter = rb_entry (rb_min (&cond->waiters),
+				struct semaphore_elem, elem);
+		rb_remove (&cond->waiters, &waiter->elem);
+		waiter->thread->wait_cond = NULL;
+		sema_up (&waiter->semaphore);
 	}
+	intr_set_level (old_level);
 }
 
 /* Wakes up all threads, if any, waiting on COND (protected by
@@ -388,6 +402,253 @@ cond_broadcast (struct condition *cond, struct lock *lock) {
 	ASSERT (cond != NULL);
 	ASSERT (lock != NULL);
 
-	while (!list_empty (&cond->waiters))
+	while (!rb_empty (&cond->waiters))
 		cond_signal (cond, lock);
 }
+
+/* Initializes RWLOCK as unheld. */
+void
+rwlock_init (struct rwlock *rw) {
+	ASSERT (rw != NULL);
+
+	rw->readers = 0;
+	rw->writer = NULL;
+	list_init (&rw->holders);
+	rb_init (&rw->read_waiters, waiter_less, NULL);
+	rb_init (&rw->write_waiters, waiter_less, NULL);
+}
+
+/* Acquires RW for reading, sleeping while a writer holds it or is
+   waiting for it.  The current thread must not already hold RW.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rwlock_acquire_read (struct rwlock *rw) {
+	enum intr_level old_level;
+
+	ASSERT (rw != NULL);
+	ASSERT (!intr_context ());
+	ASSERT (!rwlock_held_by_current_thread (rw));
+
+	old_level = intr_disable ();
+	if (rw->writer == NULL && rb_empty (&rw->write_waiters))
+		rwlock_grant (rw, thread_current (), false);
+	else
+		rwlock_wait (rw, &rw->read_waiters);
+	intr_set_level (old_level);
+}
+
+/* Releases RW, which the current thread holds for reading.  The
+   last reader out hands RW to the best waiting writer. */
+void
+rwlock_release_read (struct rwlock *rw) {
+	enum intr_level old_level;
+
+	ASSERT (rw != NULL);
+	ASSERT (rw->writer == NULL && rw->readers > 0);
+
+	old_level = intr_disable ();
+	rw->readers--;
+	rwlock_drop (rw);
+	if (rw->readers == 0)
+		rwlock_hand_off (rw);
+	intr_set_level (old_level);
+}
+
+/* Acquires RW for writing, sleeping until no thread holds it.
+   The current thread must not already hold RW.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rwlock_acquire_write (struct rwlock *rw) {
+	enum intr_level old_level;
+
+	ASSERT (rw != NULL);
+	ASSERT (!intr_context ());
+	ASSERT (!rwlock_held_by_current_thread (rw));
+
+	old_level = intr_disable ();
+	if (rw->writer == NULL && rw->readers == 0)
+		rwlock_grant (rw, thread_current (), true);
+	else
+		rwlock_wait (rw, &rw->write_waiters);
+	intr_set_level (old_level);
+}
+
+/* Releases RW, which the current thread holds for writing. */
+void
+rwlock_release_write (struct rwlock *rw) {
+	enum intr_level old_level;
+
+	ASSERT (rw != NULL);
+	ASSERT (rw->writer == thread_current ());
+
+	old_level = intr_disable ();
+	rw->writer = NULL;
+	rwlock_drop (rw);
+	rwlock_hand_off (rw);
+	intr_set_level (old_level);
+}
+
+/* Returns true if the current thread holds RW in either mode. */
+bool
+rwlock_held_by_current_thread (const struct rwlock *rw) {
+	struct thread *cur = thread_current ();
+
+	ASSERT (rw != NULL);
+
+	if (rw->writer == cur)
+		return true;
+	for (int i = 0; i < RWLOCK_HOLD_MAX; i++)
+		if (cur->rw_holds[i].rwlock == rw)
+			return true;
+	return false;
+}
+
+/* Recomputes the priority of every thread holding RW, after the
+   set of threads waiting for it changed. */
+void
+rwlock_refresh_holders (struct rwlock *rw) {
+	struct list_elem *e;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	for (e = list_begin (&rw->holders); e != list_end (&rw->holders);
+			e = list_next (e))
+		thread_refresh_priority (list_entry (e, struct rwlock_hold, elem)->thread);
+}
+
+/* Blocks the current thread in WAITERS, one of RW's waiter trees,
+   donating its priority to RW's holders.  When it wakes up, RW
+   has already been granted to it by rwlock_hand_off(). */
+static void
+rwlock_wait (struct rwlock *rw, struct rb_tree *waiters) {
+	struct thread *cur = thread_current ();
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	rb_insert (waiters, &cur->wait_elem);
+	cur->wait_queue = waiters;
+	cur->wait_on_rwlock = rw;
+	rwlock_refresh_holders (rw);
+	thread_block ();
+}
+
+/* Makes T a holder of RW, as a writer if WRITE is true, otherwise
+   as a reader, and lets T inherit from RW's remaining waiters.
+   If T already holds RWLOCK_HOLD_MAX rwlocks, it holds RW without
+   a hold slot, so no one can donate to it through RW. */
+static void
+rwlock_grant (struct rwlock *rw, struct thread *t, bool write) {
+	struct rwlock_hold *h = NULL;
+
+	for (int i = 0; i < RWLOCK_HOLD_MAX; i++)
+		if (t->rw_holds[i].rwlock == NULL) {
+			h = &t->rw_holds[i];
+			break;
+		}
+
+	if (write)
+		rw->writer = t;
+	else
+		rw->readers++;
+	if (h != NULL) {
+		h->rwlock = rw;
+		h->thread = t;
+		list_push_back (&rw->holders, &h->elem);
+		thread_refresh_priority (t);
+	}
+}
+
+/* Gives up the current thread's hold on RW and the priority it
+   inherited through it. */
+static void
+rwlock_drop (struct rwlock *rw) {
+	struct thread *cur = thread_current ();
+
+	for (int i = 0; i < RWLOCK_HOLD_MAX; i++)
+		if (cur->rw_holds[i].rwlock == rw) {
+			list_remove (&cur->rw_holds[i].elem);
+			cur->rw_holds[i].rwlock = NULL;
+			thread_refresh_priority (cur);
+			return;
+		}
+	/* Held without a slot; see rwlock_grant(). */
+}
+
+/* Called when RW has just become free.  Hands it to the best
+   waiting writer if it has at least the priority of the best
+   waiting reader, otherwise to every waiting reader at once. */
+static void
+rwlock_hand_off (struct rwlock *rw) {
+	struct rb_elem *r = rb_min (&rw->read_waiters);
+	struct rb_elem *w = rb_min (&rw->write_waiters);
+	struct thread *t;
+
+	ASSERT (rw->writer == NULL && rw->readers == 0);
+
+	if (w != NULL && (r == NULL
+				|| rb_entry (w, struct thread, wait_elem)->priority
+				>= rb_entry (r, struct thread, wait_elem)->priority)) {
+		t = rb_entry (w, struct thread, wait_elem);
+		rb_remove (&rw->write_waiters, w);
+		t->wait_queue = NULL;
+		t->wait_on_rwlock = NULL;
+		rwlock_grant (rw, t, true);
+		thread_unblock (t);
+	} else {
+		while ((r = rb_min (&rw->read_waiters)) != NULL) {
+			t = rb_entry (r, struct thread, wait_elem);
+			rb_remove (&rw->read_waiters, r);
+			t->wait_queue = NULL;
+			t->wait_on_rwlock = NULL;
+			rwlock_grant (rw, t, false);
+			thread_unblock (t);
+		}
+	}
+	check_preemption ();
+}
+
+/* Orders threads in a semaphore's waiter tree: higher priority
+   first, and first come, first served among equal priorities. */
+static bool
+waiter_less (const struct rb_elem *a_, const struct rb_elem *b_,
+		void *aux UNUSED) {
+	const struct thread *a = rb_entry (a_, struct thread, wait_elem);
+	const struct thread *b = rb_entry (b_, struct thread, wait_elem);
+
+	return a->priority > b->priority;
+}
+
+/* Orders a condition's waiters by the priority of the thread
+   behind each semaphore_elem, as waiter_less() does. */
+static bool
+cond_waiter_less (const struct rb_elem *a_, const struct rb_elem *b_,
+		void *aux UNUSED) {
+	const struct semaphore_elem *a = rb_entry (a_, struct semaphore_elem, elem);
+	const struct semaphore_elem *b = rb_entry (b_, struct semaphore_elem, elem);
+
+	return a->thread->priority > b->thread->priority;
+}
+
+/* Moves blocked thread T to the right place in the waiter trees
+   it is on, after its priority changed.  Removal does not look
+   at keys, so the old position can be found even though
+   T->priority already holds the new value.  O(log n) per tree.
+
+   Called by thread_change_priority() with interrupts off. */
+void
+synch_requeue (struct thread *t) {
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (t->wait_queue != NULL) {
+		rb_remove (t->wait_queue, &t->wait_elem);
+		rb_insert (t->wait_queue, &t->wait_elem);
+	}
+	if (t->wait_cond != NULL) {
+		rb_remove (&t->wait_cond->waiters, t->wait_cond_elem);
+		rb_insert (&t->wait_cond->waiters, t->wait_cond_elem);
+	}
+}
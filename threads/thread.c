@@ -9,18 +9,19 @@
 #include "threads/interrupt.h"
 #include "threads/intr-stubs.h"
 #include "threads/palloc.h"
+#include "threads/softirq.h"
+#include "threads/switch.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
+#include "devices/timer.h"
 #include "intrinsic.h"
 #include "threads/fixed_point.h"
+#include <rbtree.h>
 #ifdef USERPROG
 #include "userprog/process.h"
 
 #endif
 
-struct list ready_list;
-struct list sleep_list;
-
 /* Random value for struct thread's `magic' member.
    Used to detect stack overflow.  See the big comment at the top
    of thread.h for details. */
@@ -30,19 +31,33 @@ struct list sleep_list;
    Do not modify this value. */
 #define THREAD_BASIC 0xd42df210
 
-/* List of processes in THREAD_READY state, that is, processes
-   that are ready to run but not actually running. */
-//static struct list ready_list;
-
-
-
-/* [ sleep list에 있는 알람시간 중 가장 이른 알람시간 ]
-   가장 이른 알람시간 ≤ 현재 ticks 이면, 깨울 스레드가 없다는 의미이다. */
-extern int64_t MIN_alarm_time;
+/* Run queue of processes in THREAD_READY state, that is, processes
+   that are ready to run but not actually running.  One FIFO list
+   per priority level plus a bitmap of the non-empty levels, so
+   that enqueue, dequeue and "find the highest priority" are all
+   O(1).
+
+   Under the CFS (thread_cfs) the lists are unused and the ready
+   threads are kept in `cfs_tree' instead, ordered by vruntime. */
+struct runqueue {
+	struct list queues[PRI_MAX + 1];  /* One FIFO per priority. */
+	struct list batch_queues[PRI_MAX + 1]; /* Same, for SCHED_BATCH. */
+	uint64_t mask;                    /* Bit N set iff queues[N] or
+	                                     batch_queues[N] is not empty. */
+	int cnt;                          /* # of threads in queues. */
+
+	struct rb_tree cfs_tree;          /* CFS: ready threads by vruntime. */
+	int64_t min_vruntime;             /* CFS: monotonic floor of vruntimes. */
+	long cfs_load;                    /* CFS: sum of weights in cfs_tree. */
+};
+static struct runqueue ready_rq;
 
 /* Idle thread. */
 static struct thread *idle_thread;
 
+/* Returns true if T is the idle thread. */
+#define is_idle_thread(t) ((t) == idle_thread)
+
 /* Initial thread, the thread running init.c:main(). */
 static struct thread *initial_thread;
 
@@ -57,10 +72,28 @@ static long long idle_ticks;    /* # of timer ticks spent idle. */
 static long long kernel_ticks;  /* # of timer ticks in kernel threads. */
 static long long user_ticks;    /* # of timer ticks in user programs. */
 
+/* Pages of destroyed threads kept for reuse by thread_create(),
+   used as a LIFO stack so that the most recently freed (and most
+   likely cache-hot) page is handed out first.  The page allocator
+   is touched only when the cache is empty or full. */
+#define THREAD_CACHE_MAX 32
+static void *thread_cache[THREAD_CACHE_MAX];
+static size_t thread_cache_cnt;
+
 /* Scheduling. */
 #define TIME_SLICE 4            /* # of timer ticks to give each thread. */
 static unsigned thread_ticks;   /* # of timer ticks since last yield. */
 
+/* SCHED_BATCH threads start with BATCH_SLICE_MIN ticks.  Using a
+   whole slice doubles the next one, up to BATCH_SLICE_MAX, and
+   blocking before the end halves it (see batch_adapt()). */
+#define BATCH_SLICE_MIN TIME_SLICE
+#define BATCH_SLICE_MAX (8 * TIME_SLICE)
+
+/* Offset of `ksp' member within `struct thread'.
+   Used by switch.S, which can't figure it out on its own. */
+uint32_t thread_stack_ofs = offsetof (struct thread, ksp);
+
 /* If false (default), use round-robin scheduler.
    If true, use multi-level feedback queue scheduler.
    Controlled by kernel command-line option "-o mlfqs". */
@@ -71,16 +104,60 @@ int load_avg;
 #define LOAD_AVG_DEFAULT 0
 static struct list all_list;
 
+/* If true, use the completely fair scheduler instead.
+   Controlled by kernel command-line option "-cfs".  Target
+   latency and minimum granularity are in timer ticks and can be
+   set with "-cfs-latency=N" and "-cfs-granularity=N". */
+bool thread_cfs;
+int cfs_latency = 8;
+int cfs_min_granularity = 1;
+
+/* A nice-0 thread's vruntime advances by CFS_VR_UNIT per tick it
+   runs; heavier threads advance proportionally slower. */
+#define CFS_NICE_0_WEIGHT 1024
+#define CFS_VR_UNIT 1024
+
+/* load_avg = LOAD_AVG_DECAY * load_avg + LOAD_AVG_GAIN * ready_threads,
+   i.e. 59/60 and 1/60 in 17.14 fixed point. */
+#define LOAD_AVG_DECAY (59 * F / 60)
+#define LOAD_AVG_GAIN (F / 60)
+
+/* recent_cpu decay epochs.  Each once-a-second decay bumps
+   mlfqs_epoch and records the coefficient it used, so that a
+   thread that was blocked across several decays can replay them
+   when it next becomes runnable. */
+#define DECAY_HISTORY 64
+#define DECAY_CATCHUP_MAX (2 * DECAY_HISTORY)
+static int64_t mlfqs_epoch;
+static int decay_history[DECAY_HISTORY];
+
 static void kernel_thread (thread_func *, void *aux);
 
 static void idle (void *aux UNUSED);
 static struct thread *next_thread_to_run (void);
 static void init_thread (struct thread *, const char *name, int priority);
+static bool mlfqs_exempt (const struct thread *);
+static bool mlfqs_catch_up (struct thread *);
+static int mlfqs_calc_priority (const struct thread *);
+static void runqueue_init (struct runqueue *);
+static void rq_push (struct runqueue *, struct thread *);
+static struct thread *rq_pop_highest (struct runqueue *);
+static int rq_highest_priority (const struct runqueue *);
+static void ready_push (struct thread *);
+static void ready_remove (struct thread *);
+static struct thread *thread_page_get (void);
+static bool cfs_less (const struct rb_elem *, const struct rb_elem *, void *);
+static long cfs_weight (const struct thread *);
+static void cfs_update_min_vruntime (struct runqueue *, const struct thread *);
+static void cfs_tick (struct thread *);
+static void cfs_place (struct runqueue *, struct thread *);
+static bool cfs_should_preempt (const struct thread *);
+static unsigned thread_slice (const struct thread *);
+static void batch_adapt (struct thread *, unsigned ticks);
 static void do_schedule(int status);
 static void schedule (void);
 static tid_t allocate_tid (void);
 
-//bool thread_compare_priority(struct list_elem *a, struct list_elem *b, void *aux UNUSED);
 // static void check_preemption(void);
 /* Returns true if T appears to point to a valid thread. */
 #define is_thread(t) ((t) != NULL && (t)->magic == THREAD_MAGIC)
@@ -126,9 +203,8 @@ thread_init (void) {//최초의 스레드 부르기
 
 	/* Init the globla thread context */
 	lock_init (&tid_lock);
-	list_init (&ready_list);
+	runqueue_init (&ready_rq);
 	list_init (&destruction_req);
-	list_init(&sleep_list);
 	list_init(&all_list);
 
 	// t->init_prioirty = priority;
@@ -180,10 +256,21 @@ thread_tick (void) {
 		kernel_ticks++;
 
 	/* Enforce preemption. */
-	if (++thread_ticks >= TIME_SLICE)
+	++thread_ticks;
+	if (thread_cfs) {
+		if (t != idle_thread)
+			cfs_tick (t);
+	} else if (thread_ticks >= thread_slice (t))
 		intr_yield_on_return ();
 }
 
+/* Credits CNT timer ticks that went by while the idle thread had
+   the periodic tick switched off (see timer_idle_enter()). */
+void
+thread_tick_idle (int64_t cnt) {
+	idle_ticks += cnt;
+}
+
 /* Prints thread statistics. */
 void
 thread_print_stats (void) {
@@ -209,30 +296,36 @@ thread_print_stats (void) {
 tid_t
 thread_create (const char *name, int priority,
 		thread_func *function, void *aux) {
+	struct switch_threads_frame *sf;
 	struct thread *t;
 	tid_t tid;
 
 	ASSERT (function != NULL);
 
-	/* Allocate thread. */
-	t = palloc_get_page (PAL_ZERO);
+	/* Allocate thread.  init_thread() clears the struct thread
+	   itself; the stack part of the page need not be zeroed. */
+	t = thread_page_get ();
 	if (t == NULL)
 		return TID_ERROR;
 
-	/* Initialize thread. */
+	/* Initialize thread.  It inherits our scheduling class. */
 	init_thread (t, name, priority);
+	t->sched_class = thread_current ()->sched_class;
+	t->vruntime = ready_rq.min_vruntime;
 	tid = t->tid = allocate_tid ();
 
 	/* Call the kernel_thread if it scheduled.
-	 * Note) rdi is 1st argument, and rsi is 2nd argument. */
-	t->tf.rip = (uintptr_t) kernel_thread;
-	t->tf.R.rdi = (uint64_t) function;
-	t->tf.R.rsi = (uint64_t) aux;
-	t->tf.ds = SEL_KDSEG;
-	t->tf.es = SEL_KDSEG;
-	t->tf.ss = SEL_KDSEG;
-	t->tf.cs = SEL_KCSEG;
-	t->tf.eflags = FLAG_IF;
+	 * The first switch_threads() into T pops this frame and
+	 * "returns" to switch_entry, which calls r12 (r13, r14).
+	 * The frame ends 16 bytes below the top of the page so that
+	 * kernel_thread() starts with a correctly aligned stack. */
+	sf = (struct switch_threads_frame *) ((uint8_t *) t + PGSIZE - 16) - 1;
+	memset (sf, 0, sizeof *sf);
+	sf->r12 = (uint64_t) kernel_thread;
+	sf->r13 = (uint64_t) function;
+	sf->r14 = (uint64_t) aux;
+	sf->rip = switch_entry;
+	t->ksp = (uint64_t) sf;
 
 	list_push_back(&all_list, &t->allelem);
 	/* Add to run queue. */
@@ -277,8 +370,13 @@ thread_unblock (struct thread *t) {
 
 	old_level = intr_disable ();
 	ASSERT (t->status == THREAD_BLOCKED);
-	//list_push_back (&ready_list, &t->elem);
-	list_insert_ordered(&ready_list, &t->elem, thread_compare_priority, 0);
+	if (thread_mlfqs && !mlfqs_exempt (t) && mlfqs_catch_up (t)) {
+		/* recent_cpu decayed while T was blocked. */
+		t->priority = mlfqs_calc_priority (t);
+	}
+	if (thread_cfs)
+		cfs_place (&ready_rq, t);
+	ready_push (t);
 	t->status = THREAD_READY;
 	intr_set_level (old_level);
 }
@@ -341,28 +439,62 @@ thread_yield (void) {
 	ASSERT (!intr_context ());//외부 인터럽트가 들어왔으면 True, 아니면 False
 
 	old_level = intr_disable ();
-	if (curr != idle_thread)
-		list_insert_ordered(&ready_list, &curr->elem, thread_compare_priority, 0);
-		//list_push_back (&ready_list, &curr->elem);//ready리스트 맨 마지막에 curr
+	if (!is_idle_thread (curr))
+		ready_push (curr);//자기 우선순위 큐의 맨 뒤로
 	do_schedule (THREAD_READY);//컨텍스트 스위칭,  running->ready
 	intr_set_level (old_level);
 }
-//list_insert 함수 두번째 인자에 해당하는 스레드가 첫번째 인자에 해당하는 스레드 앞에옴
-/* 스레드의 우선 순위를 비교한다 */
 
+void check_preemption(void){
+	//현재 실행중인 스레드 보다 ready 큐의 최고 우선순위가 높으면, CPU yield
+	enum intr_level old_level = intr_disable ();
+	struct thread *curr = thread_current ();
+	struct runqueue *rq = &ready_rq;
+	bool preempt;
+	if (thread_cfs)
+		preempt = cfs_should_preempt (curr);
+	else {
+		/* A batch thread also gives way to a ready interactive
+		   thread of its own priority. */
+		int highest = rq_highest_priority (rq);
+		preempt = curr->priority < highest
+			|| (curr->sched_class == SCHED_BATCH && curr->priority == highest
+				&& !list_empty (&rq->queues[highest]));
+	}
+	intr_set_level (old_level);
 
-bool thread_compare_priority(struct list_elem *a, struct list_elem *b, void *aux UNUSED) {
-	return list_entry(a, struct thread, elem)->priority > list_entry(b, struct thread, elem)->priority;
+	if (preempt) {
+		if (intr_context ())
+			intr_yield_on_return ();
+		else
+			thread_yield ();
+	}
 }
 
+/* Changes T's priority to PRIORITY.  If T is sitting in the run
+   queue it is moved to the queue of its new priority, and if it
+   is waiting on a semaphore or condition it is re-keyed there, so
+   callers (donation, MLFQS recalculation) must always go through
+   here instead of writing T->priority directly. */
+void
+thread_change_priority (struct thread *t, int priority) {
+	enum intr_level old_level;
 
-void check_preemption(void){
-	//현재 실행중인 스레드 보다 삽입된 스레드의 우선순위가 높으면, CPU yield
-	if (!list_empty(&ready_list) &&
-	thread_current()->priority < list_entry(list_front(&ready_list), struct thread, elem)->priority) {
-	thread_yield();
-	}
+	ASSERT (is_thread (t));
+	ASSERT (PRI_MIN <= priority && priority <= PRI_MAX);
 
+	old_level = intr_disable ();
+	if (t->priority != priority) {
+		if (t->status == THREAD_READY) {
+			ready_remove (t);
+			t->priority = priority;
+			ready_push (t);
+		} else {
+			t->priority = priority;
+			synch_requeue (t);
+		}
+	}
+	intr_set_level (old_level);
 }
 
 /* Sets the current thread's priority to NEW_PRIORITY.
@@ -380,12 +512,42 @@ thread_set_priority (int new_priority) {
 	}
 	
 	thread_current ()->init_priority = new_priority;
-	thread_current ()->priority = new_priority;
-
-	refresh_priority();
+	thread_refresh_priority (thread_current ());
 	check_preemption();
 }
 
+/* Puts the current thread in scheduling class CLASS, SCHED_NORMAL
+   or SCHED_BATCH, and returns its previous class, or -1 if CLASS
+   is not a class.  A thread entering SCHED_BATCH starts with the
+   shortest batch quantum and earns longer ones by using them. */
+int
+thread_set_class (int class) {
+	struct thread *curr = thread_current ();
+	enum intr_level old_level;
+	int old_class;
+
+	if (class != SCHED_NORMAL && class != SCHED_BATCH)
+		return -1;
+
+	old_level = intr_disable ();
+	old_class = curr->sched_class;
+	if (class != old_class) {
+		curr->sched_class = class;
+		curr->quantum = BATCH_SLICE_MIN;
+	}
+	intr_set_level (old_level);
+
+	/* An interactive thread of our priority may be waiting. */
+	check_preemption ();
+	return old_class;
+}
+
+/* Returns the current thread's scheduling class. */
+int
+thread_get_class (void) {
+	return thread_current ()->sched_class;
+}
+
 /* Returns the current thread's priority. 
 현재 스레드의 우선 순위를 반환한다. */
 int
@@ -395,7 +557,7 @@ thread_get_priority (void) {
 
 /* Sets the current thread's nice value to NICE. */
 void
-thread_set_nice (int nice UNUSED) {
+thread_set_nice (int nice) {
 	// 현재 스레드의 nice값을 변경하는 함수를 구현한다.
 	// 해당 작업중에 인터럽트는 비활성화 해야한다
 	// 현재 스레드의 nice값을 변경한다
@@ -404,9 +566,15 @@ thread_set_nice (int nice UNUSED) {
 	struct thread *t = thread_current();
 	enum intr_level old_level;
 
+	if (nice < NICE_MIN)
+		nice = NICE_MIN;
+	else if (nice > NICE_MAX)
+		nice = NICE_MAX;
+
 	old_level = intr_disable();
 	t->nice = nice;
-	mlfqs_priority(t);
+	if (!thread_cfs)
+		mlfqs_priority(t);
 	check_preemption();
 	intr_set_level(old_level);
 }
@@ -483,7 +651,12 @@ idle (void *idle_started_ UNUSED) {
 		   time.
 
 		   See [IA32-v2a] "HLT", [IA32-v2b] "STI", and [IA32-v3a]
-		   7.11.1 "HLT Instruction". */
+		   7.11.1 "HLT Instruction".
+
+		   In tickless mode the timer is first switched to a single
+		   interrupt at the next wakeup deadline. */
+		timer_idle_enter ();
+		intr_off_end ();
 		asm volatile ("sti; hlt" : : : "memory");
 	}
 }
@@ -510,17 +683,21 @@ init_thread (struct thread *t, const char *name, int priority) {//스레드 만
 	memset (t, 0, sizeof *t);
 	t->status = THREAD_BLOCKED;
 	strlcpy (t->name, name, sizeof t->name);
-	t->tf.rsp = (uint64_t) t + PGSIZE - sizeof (void *);
 	t->priority = priority;
 	t->magic = THREAD_MAGIC;
 
     t->init_priority = priority;
 	t->wait_on_lock = NULL;
-	list_init(&t->donations);
+	list_init(&t->held_locks);
 	//advanced
 	t->nice = NICE_DEFAULT;
     t->recent_cpu = RECENT_CPU_DEFAULT;
-
+	t->recent_cpu_epoch = mlfqs_epoch;
+	t->sched_class = SCHED_NORMAL;
+	t->quantum = BATCH_SLICE_MIN;
+#ifdef USERPROG
+	list_init (&t->segments);
+#endif
 }
 
 /* Chooses and returns the next thread to be scheduled.  Should
@@ -530,15 +707,126 @@ init_thread (struct thread *t, const char *name, int priority) {//스레드 만
    idle_thread. */
 static struct thread *
 next_thread_to_run (void) {
-	if (list_empty (&ready_list))
-		return idle_thread;
-	else
-		return list_entry (list_pop_front (&ready_list), struct thread, elem);
+	struct thread *next = rq_pop_highest (&ready_rq);
+	return next != NULL ? next : idle_thread;
+}
+
+/* Initializes RQ as an empty run queue. */
+static void
+runqueue_init (struct runqueue *rq) {
+	for (int i = PRI_MIN; i <= PRI_MAX; i++) {
+		list_init (&rq->queues[i]);
+		list_init (&rq->batch_queues[i]);
+	}
+	rq->mask = 0;
+	rq->cnt = 0;
+	rb_init (&rq->cfs_tree, cfs_less, NULL);
+	rq->min_vruntime = 0;
+	rq->cfs_load = 0;
+}
+
+/* Returns the queue that T belongs in on RQ at its current
+   priority.  Batch threads wait behind every other thread of
+   their priority. */
+static struct list *
+rq_queue (struct runqueue *rq, const struct thread *t) {
+	return t->sched_class == SCHED_BATCH
+		? &rq->batch_queues[t->priority] : &rq->queues[t->priority];
+}
+
+/* Clears PRI in RQ's occupancy mask if nothing is left there. */
+static void
+rq_update_mask (struct runqueue *rq, int pri) {
+	if (list_empty (&rq->queues[pri]) && list_empty (&rq->batch_queues[pri]))
+		rq->mask &= ~(1ULL << pri);
+}
+
+/* Appends T to RQ at T's current priority. */
+static void
+rq_push (struct runqueue *rq, struct thread *t) {
+	if (thread_cfs) {
+		rb_insert (&rq->cfs_tree, &t->cfs_elem);
+		rq->cfs_load += cfs_weight (t);
+	} else {
+		list_push_back (rq_queue (rq, t), &t->elem);
+		rq->mask |= 1ULL << t->priority;
+	}
+	rq->cnt++;
+}
+
+/* Returns the highest priority that has a ready thread in RQ, or
+   -1 if RQ is empty.  A single bsr on the occupancy mask. */
+static int
+rq_highest_priority (const struct runqueue *rq) {
+	uint64_t mask = rq->mask;
+	uint64_t bit;
+
+	if (mask == 0)
+		return -1;
+	__asm __volatile ("bsrq %1, %0" : "=r" (bit) : "rm" (mask));
+	return (int) bit;
+}
+
+/* Removes and returns the first thread of the highest non-empty
+   priority level of RQ, or a null pointer if RQ is empty. */
+static struct thread *
+rq_pop_highest (struct runqueue *rq) {
+	int pri = rq_highest_priority (rq);
+	struct list *q;
+	struct thread *t;
+
+	if (thread_cfs) {
+		if (rb_empty (&rq->cfs_tree))
+			return NULL;
+		t = rb_entry (rb_min (&rq->cfs_tree), struct thread, cfs_elem);
+		rb_remove (&rq->cfs_tree, &t->cfs_elem);
+		rq->cfs_load -= cfs_weight (t);
+		rq->cnt--;
+		cfs_update_min_vruntime (rq, t);
+		return t;
+	}
+	if (pri < 0)
+		return NULL;
+	q = &rq->queues[pri];
+	if (list_empty (q))
+		q = &rq->batch_queues[pri];
+	t = list_entry (list_pop_front (q), struct thread, elem);
+	rq_update_mask (rq, pri);
+	rq->cnt--;
+	return t;
+}
+
+/* Appends T to the run queue. */
+static void
+ready_push (struct thread *t) {
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	rq_push (&ready_rq, t);
+}
+
+/* Takes T, which must be in the run queue, out of it. */
+static void
+ready_remove (struct thread *t) {
+	struct runqueue *rq = &ready_rq;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+	ASSERT (t->status == THREAD_READY);
+
+	if (thread_cfs) {
+		rb_remove (&rq->cfs_tree, &t->cfs_elem);
+		rq->cfs_load -= cfs_weight (t);
+	} else {
+		list_remove (&t->elem);
+		rq_update_mask (rq, t->priority);
+	}
+	rq->cnt--;
 }
 
 /* Use iretq to launch the thread */
 void
 do_iret (struct intr_frame *tf) {
+	if (tf->eflags & FLAG_IF)
+		intr_off_end ();
 	__asm __volatile(
 			"movq %0, %%rsp\n"
 			"movq 0(%%rsp),%%r15\n"
@@ -564,73 +852,21 @@ do_iret (struct intr_frame *tf) {
 			: : "g" ((uint64_t) tf) : "memory");
 }
 
-/* Switching the thread by activating the new thread's page
-   tables, and, if the previous thread is dying, destroying it.
+/* Switches from the running thread to TH.
 
-   At this function's invocation, we just switched from thread
-   PREV, the new thread is already running, and interrupts are
-   still disabled.
+   Only the callee-saved registers and the stack pointer are
+   saved, on the old thread's own kernel stack (see switch.S).
+   Going back to user mode is left to the interrupt return path
+   (intr_exit) or to do_iret() in process.c, so no iretq happens
+   on a kernel-to-kernel switch.
 
-   It's not safe to call printf() until the thread switch is
-   complete.  In practice that means that printf()s should be
-   added at the end of the function. */
+   Interrupts must be off.  It's not safe to call printf() until
+   the thread switch is complete. */
 static void
 thread_launch (struct thread *th) {
-	uint64_t tf_cur = (uint64_t) &running_thread ()->tf;
-	uint64_t tf = (uint64_t) &th->tf;
 	ASSERT (intr_get_level () == INTR_OFF);
 
-	/* The main switching logic.
-	 * We first restore the whole execution context into the intr_frame
-	 * and then switching to the next thread by calling do_iret.
-	 * Note that, we SHOULD NOT use any stack from here
-	 * until switching is done. */
-	__asm __volatile (
-			/* Store registers that will be used. */
-			"push %%rax\n"
-			"push %%rbx\n"
-			"push %%rcx\n"
-			/* Fetch input once */
-			"movq %0, %%rax\n"
-			"movq %1, %%rcx\n"
-			"movq %%r15, 0(%%rax)\n"
-			"movq %%r14, 8(%%rax)\n"
-			"movq %%r13, 16(%%rax)\n"
-			"movq %%r12, 24(%%rax)\n"
-			"movq %%r11, 32(%%rax)\n"
-			"movq %%r10, 40(%%rax)\n"
-			"movq %%r9, 48(%%rax)\n"
-			"movq %%r8, 56(%%rax)\n"
-			"movq %%rsi, 64(%%rax)\n"
-			"movq %%rdi, 72(%%rax)\n"
-			"movq %%rbp, 80(%%rax)\n"
-			"movq %%rdx, 88(%%rax)\n"
-			"pop %%rbx\n"              // Saved rcx
-			"movq %%rbx, 96(%%rax)\n"
-			"pop %%rbx\n"              // Saved rbx
-			"movq %%rbx, 104(%%rax)\n"
-			"pop %%rbx\n"              // Saved rax
-			"movq %%rbx, 112(%%rax)\n"
-			"addq $120, %%rax\n"
-			"movw %%es, (%%rax)\n"
-			"movw %%ds, 8(%%rax)\n"
-			"addq $32, %%rax\n"
-			"call __next\n"         // read the current rip.
-			"__next:\n"
-			"pop %%rbx\n"
-			"addq $(out_iret -  __next), %%rbx\n"
-			"movq %%rbx, 0(%%rax)\n" // rip
-			"movw %%cs, 8(%%rax)\n"  // cs
-			"pushfq\n"
-			"popq %%rbx\n"
-			"mov %%rbx, 16(%%rax)\n" // eflags
-			"mov %%rsp, 24(%%rax)\n" // rsp
-			"movw %%ss, 32(%%rax)\n"
-			"mov %%rcx, %%rdi\n"
-			"call do_iret\n"
-			"out_iret:\n"
-			: : "g"(tf_cur), "g" (tf) : "memory"
-			);
+	switch_threads (running_thread (), th);
 }
 
 /* Schedules a new process. At entry, interrupts must be off.
@@ -644,7 +880,10 @@ do_schedule(int status) {
 	while (!list_empty (&destruction_req)) {//종료예약된스레드
 		struct thread *victim =
 			list_entry (list_pop_front (&destruction_req), struct thread, elem);
-		palloc_free_page(victim);
+		if (thread_cache_cnt < THREAD_CACHE_MAX)
+			thread_cache[thread_cache_cnt++] = victim;
+		else
+			palloc_free_page (victim);
 	}
 	thread_current ()->status = status;
 	schedule ();
@@ -662,8 +901,14 @@ schedule (void) {
 	next->status = THREAD_RUNNING;
 
 	/* Start new time slice. */
+	if (curr->sched_class == SCHED_BATCH)
+		batch_adapt (curr, thread_ticks);
 	thread_ticks = 0;
 
+	/* Leaving the idle thread: restore the periodic tick. */
+	if (curr == idle_thread && next != idle_thread)
+		timer_idle_exit ();
+
 #ifdef USERPROG
 	/* Activate the new address space. */
 	process_activate (next);
@@ -688,6 +933,44 @@ schedule (void) {
 	}
 }
 
+/* Returns the number of ticks T may run before the timer tick
+   preempts it (outside the CFS). */
+static unsigned
+thread_slice (const struct thread *t) {
+	return t->sched_class == SCHED_BATCH ? (unsigned) t->quantum : TIME_SLICE;
+}
+
+/* Adapts batch thread T's quantum as it leaves the CPU after
+   TICKS ticks.  Running to the end of its slice marks it as
+   CPU-bound and doubles the next one; blocking before the end
+   halves it.  Being preempted or yielding changes nothing. */
+static void
+batch_adapt (struct thread *t, unsigned ticks) {
+	if (ticks >= (unsigned) t->quantum) {
+		if (t->quantum < BATCH_SLICE_MAX)
+			t->quantum *= 2;
+	} else if (t->status == THREAD_BLOCKED && t->quantum > BATCH_SLICE_MIN)
+		t->quantum /= 2;
+}
+
+/* Returns a page for a new thread, from thread_cache if it has
+   one, otherwise from the page allocator.  The page is not
+   zeroed.  Returns a null pointer if no memory is available. */
+static struct thread *
+thread_page_get (void) {
+	struct thread *t = NULL;
+	enum intr_level old_level;
+
+	old_level = intr_disable ();
+	if (thread_cache_cnt > 0)
+		t = thread_cache[--thread_cache_cnt];
+	intr_set_level (old_level);
+
+	if (t == NULL)
+		t = palloc_get_page (0);
+	return t;
+}
+
 /* Returns a tid to use for a new thread. */
 static tid_t
 allocate_tid (void) {
@@ -701,119 +984,146 @@ allocate_tid (void) {
 	return tid;
 }
 
-//nested
-//multiple 한번에 여러개 lock이 필요하면 왔다 갔다 한개씩 모두 획득해야 작업시작
-void donate_priority(void) {
-	//priority donation 을 수행하는 함수를 구현한다.
-	//현재 스레드가 기다리고 있는 lock과 연결된 모든 스레드들을 순회하며
-	//현재 스레드의 우선순위를 lock을 보유하고 있는 스레드에게 기부한다
-	//nested depth 는 8로 제한한다
-	int cnt = 0;
-	struct thread *t = thread_current();
-	int cur_priority = t->priority; //이전 스레드 우선순위 기억
+/* Returns the highest priority among the threads waiting for
+   LOCK, or PRI_MIN if there are none.  O(1): the waiter tree
+   keeps its best thread leftmost (see synch_requeue()). */
+static int
+lock_top_priority (const struct lock *lock) {
+	struct rb_elem *e = rb_min (&lock->semaphore.waiters);
 
-	while (cnt < 9) {
-		cnt++;
-		if (t->wait_on_lock == NULL) {//현재 스레드가 기다리고 있는 락이 없으면 종료
-			break;
-		}
-		t = t->wait_on_lock->holder; //홀더 전달
-		t->priority = cur_priority; //우선순위 기부
-	}
+	return e != NULL ? rb_entry (e, struct thread, wait_elem)->priority : PRI_MIN;
 }
 
-void remove_with_lock(struct lock *lock) {
-	//lock을 해지 했을 때 donations 리스트에서 해당 엔트리를 삭제하기 위한 함수 구현
-	//현재 스레드의 donations 리스트를 확인하여 해지 할 lock을 보유하고 잇는 엔트리 삭제
-	struct thread *t = thread_current();
-	struct list_elem *e = list_begin(&t->donations);
-	//리스트의 처음부터 끝까지 확인하여
-	for (e; e!=list_end(&t->donations);) {
-		struct thread *cur = list_entry(e, struct thread, donation_elem);
+/* Returns the highest priority among the threads waiting for
+   RW in either mode, or PRI_MIN if there are none. */
+static int
+rwlock_top_priority (const struct rwlock *rw) {
+	struct rb_elem *r = rb_min (&rw->read_waiters);
+	struct rb_elem *w = rb_min (&rw->write_waiters);
+	int priority = PRI_MIN;
+
+	if (r != NULL)
+		priority = rb_entry (r, struct thread, wait_elem)->priority;
+	if (w != NULL && rb_entry (w, struct thread, wait_elem)->priority > priority)
+		priority = rb_entry (w, struct thread, wait_elem)->priority;
+	return priority;
+}
 
-		if (cur->wait_on_lock == lock) {
-			e = list_remove(e);
-		} else {
-			e = list_next(e);
+/* Priority donation.
+   T's effective priority is the larger of its own (init_priority)
+   and the best waiter of every lock and rwlock it holds, which
+   costs O(held locks).  If that changes T's priority and T is
+   itself waiting for a lock, T moves in that lock's waiter tree,
+   which may change what the lock's holder inherits, so the update
+   walks up the wait-for chain until some holder's priority is
+   unchanged.  An rwlock may have several holders; each of them is
+   refreshed in turn.
+
+   Called after T acquires or releases a lock, after a thread
+   starts waiting for a lock T holds, and after T's own priority
+   is set. */
+void
+thread_refresh_priority (struct thread *t) {
+	enum intr_level old_level;
+
+	if (thread_mlfqs)
+		return;
+
+	old_level = intr_disable ();
+	while (t != NULL) {
+		int priority = t->init_priority;
+		struct list_elem *e;
+
+		for (e = list_begin (&t->held_locks); e != list_end (&t->held_locks);
+				e = list_next (e)) {
+			int donated = lock_top_priority (list_entry (e, struct lock, elem));
+			if (donated > priority)
+				priority = donated;
+		}
+		for (int i = 0; i < RWLOCK_HOLD_MAX; i++)
+			if (t->rw_holds[i].rwlock != NULL) {
+				int donated = rwlock_top_priority (t->rw_holds[i].rwlock);
+				if (donated > priority)
+					priority = donated;
+			}
+		if (priority == t->priority)
+			break;
+		thread_change_priority (t, priority);
+		if (t->wait_on_rwlock != NULL) {
+			rwlock_refresh_holders (t->wait_on_rwlock);
+			break;
 		}
+		t = t->wait_on_lock != NULL ? t->wait_on_lock->holder : NULL;
 	}
+	intr_set_level (old_level);
 }
 
-// void remove_with_lock (struct lock *lock)
-// {
-// 	struct thread *t = thread_current();
-// 	struct list_elem *e = list_begin(&t->donations);
- 
-// 	for (e ; e != list_end((&t->donations));)
-// 	{
-// 		struct thread *cur = list_entry(e, struct thread, donation_elem);
-// 		if (cur->wait_on_lock == lock)
-// 		{
-// 			e = list_remove(e);
-// 		}
-// 		else
-// 		{
-// 			e = list_next(e);
-// 		}
-// 	}
-// }
-
-
-void refresh_priority(void) {
-	//스레드의 우선순위가 변경 되었을 때 donation을 고려하여 우선순위 다시 결정
-	//현재 스레드의 우선순위를 기부받기 전의 우선순위로 변경
-	//가장 우선순위가 높은 donations리스트의 스레드와 현재 스레드의 우선순위를 비교하여 높은 값을
-	//현재 스레드의 우선 순위로 설정한다
-	struct thread *t = thread_current();
-	t->priority = t->init_priority;
-	//struct list_elem * e = list_begin(&t->donations);
-	
-	if (list_empty(&t->donations) == false) { //도네이션 리스트가 빌 때까지
-		//list_sort(&t->donations, thread_compare_priority, 0);
-		struct thread *first = list_entry(list_front(&t->donations), struct thread, donation_elem);
-		if (first->priority > t->priority) {
-			t->priority = first->priority;
-		}
+/* Returns the MLFQS priority of T from its recent_cpu and nice,
+   clamped to PRI_MIN...PRI_MAX. */
+static int
+mlfqs_calc_priority (const struct thread *t) {
+	// priority = PRI_MAX - (recent_cpu / 4) - (nice * 2),
+	int recent_cpu_by_4 = div_mixed(t->recent_cpu, 4);
+	int nice_by_2 = 2 * t->nice;
+	int to_sub = add_mixed(recent_cpu_by_4, nice_by_2);
+	int sub = sub_mixed(to_sub, (int)PRI_MAX);
+	int pri_result = fp_to_int(sub_fp(0, sub));
+	if (pri_result < PRI_MIN) {
+		pri_result = PRI_MIN;
+	} 
+	if (pri_result > PRI_MAX) {
+		pri_result = PRI_MAX;
 	}
+	return pri_result;
 }
 
+/* One per-second decay step of RECENT_CPU with decay coefficient
+   COEFF = (2 * load_avg) / (2 * load_avg + 1). */
+static int
+mlfqs_decay (int recent_cpu, int coeff, int nice) {
+	//recent_cpu = (2 * load_avg)/(2 * load_avg + 1)* recent_cpu+nice
+	int result = add_mixed(mult_fp(coeff, recent_cpu), nice);
+	if (result < 0) {
+		result = 0;
+	}
+	return result;
+}
 
+/* Returns true if the MLFQS leaves T alone: the idle thread, and
+   softirqd, which does work on behalf of whichever thread was
+   interrupted.  Neither is charged recent_cpu, counted in
+   load_avg or re-prioritized, so softirqd keeps PRI_MAX. */
+static bool
+mlfqs_exempt (const struct thread *t) {
+	return is_idle_thread (t) || t == softirq_thread ();
+}
 
-
-void mlfqs_priority (struct thread *t) {
-	// 해당 스레드가 idle_thread 가 아닌지 검사
-	// priority 계산식을 구현(fixed_point.h의 계산함수 이용)
-	if (t != idle_thread) {
-		// priority = PRI_MAX - (recent_cpu / 4) - (nice * 2),
-		int recent_cpu_by_4 = div_mixed(t->recent_cpu, 4);
-		int nice_by_2 = 2 * t->nice;
-		int to_sub = add_mixed(recent_cpu_by_4, nice_by_2);
-		int sub = sub_mixed(to_sub, (int)PRI_MAX);
-		int pri_result = fp_to_int(sub_fp(0, sub));
-		if (pri_result < PRI_MIN) {
-			pri_result = PRI_MIN;
-		} 
-		if (pri_result > PRI_MAX) {
-			pri_result = PRI_MAX;
-		}
-		t->priority = pri_result;
+/* Brings T's recent_cpu up to date with the decays it missed
+   while it was blocked.  Epochs older than DECAY_HISTORY reuse the
+   oldest recorded coefficient, and at most DECAY_CATCHUP_MAX
+   epochs are replayed; past that recent_cpu has long since
+   settled.  Returns true if any decay was applied. */
+static bool
+mlfqs_catch_up (struct thread *t) {
+	int64_t missed = mlfqs_epoch - t->recent_cpu_epoch;
+	int64_t oldest = mlfqs_epoch - DECAY_HISTORY + 1;
+	int64_t e;
+
+	if (missed > DECAY_CATCHUP_MAX)
+		missed = DECAY_CATCHUP_MAX;
+	for (e = mlfqs_epoch - missed + 1; e <= mlfqs_epoch; e++) {
+		int coeff = decay_history[(e < oldest ? oldest : e) % DECAY_HISTORY];
+		t->recent_cpu = mlfqs_decay (t->recent_cpu, coeff, t->nice);
 	}
+	t->recent_cpu_epoch = mlfqs_epoch;
+	return missed > 0;
 }
 
-void mlfqs_recent_cpu (struct thread *t) {
+void mlfqs_priority (struct thread *t) {
 	// 해당 스레드가 idle_thread 가 아닌지 검사
-	// recent_cpu 계산식 구현(fixed_point.h의 계산함수 이용)
-	if (t != idle_thread) {
-//recent_cpu = (2 * load_avg)/(2 * load_avg + 1)* recent_cpu+nice
-		int load_avg_2 = mult_mixed(load_avg, 2);//여기반대로씀
-		int load_avg_2_1 = add_mixed(load_avg_2, 1);
-		int frac = div_fp(load_avg_2, load_avg_2_1);
-		int tmp = mult_fp(frac, t->recent_cpu);//mixed라씀
-		int result = add_mixed(tmp, t->nice);
-		if ((result >> 31) == (-1) >> 31) {
-			result = 0;
-		}
-		t->recent_cpu = result;
+	// priority 계산식을 구현(fixed_point.h의 계산함수 이용)
+	if (!mlfqs_exempt (t)) {
+		thread_change_priority (t, mlfqs_calc_priority (t));
 	}
 }
 
@@ -821,13 +1131,15 @@ void mlfqs_load_avg (void) {
 	// load_avg 계산식 구현(fixed_point.h이용)
 	// load_avg는 0보다 작아질 수 없다
 	// load_avg = (59/60) * load_avg + (1/60) * ready_threads
-	// readythread는 readylist의 크기
-	int a = div_fp(int_to_fp(59), int_to_fp(60));
-	int b = div_fp(int_to_fp(1), int_to_fp(60));//여기1이라씀 뒤에를
-	int load_avg2 = mult_fp(a, load_avg);//여기a,b라씀
-	int ready_thread = (int)list_size(&ready_list);
-	ready_thread = (thread_current() == idle_thread) ? ready_thread : ready_thread + 1;
-	int ready_thread2 = mult_mixed(b, ready_thread);
+	// readythread는 ready 큐의 크기 + 실행중인 스레드
+	int load_avg2 = mult_fp(LOAD_AVG_DECAY, load_avg);
+	struct thread *softirqd = softirq_thread ();
+	int ready_thread = ready_rq.cnt;
+	if (!mlfqs_exempt (thread_current ()))
+		ready_thread++;
+	if (softirqd != NULL && softirqd->status == THREAD_READY)
+		ready_thread--;
+	int ready_thread2 = mult_mixed(LOAD_AVG_GAIN, ready_thread);
 	int result = add_fp(load_avg2, ready_thread2);
 	load_avg = result;
 
@@ -836,23 +1148,199 @@ void mlfqs_load_avg (void) {
 void mlfqs_increment (void) {
 	// 해당 스레드가 idle 스레드가 아닌지 검사
 	// 현재 스레드의 recent_cpu 값을 1 증가 시킨다
-	if (thread_current() != idle_thread) {
+	if (!mlfqs_exempt (thread_current ())) {
 		int cur_recent_cpu = thread_current()->recent_cpu;
 		thread_current()->recent_cpu = add_mixed(cur_recent_cpu, 1);
 	}
 }
 
+/* Once-a-second recent_cpu decay.  The coefficient is computed once
+   and recorded as a new epoch.  Only the running thread and the
+   threads in the run queue are decayed (and re-prioritized) now;
+   blocked threads catch up in thread_unblock(), so the cost here
+   does not depend on how many threads are asleep. */
 void mlfqs_recalc_recent_cpu (void) {
-	//모든 스레드의 recent_cpu 재계산
-	for (struct list_elem *e = list_begin(&all_list); e != list_end(&all_list); e = list_next(e)) {
-		mlfqs_recent_cpu(list_entry(e, struct thread, allelem));
+	int load_avg_2 = mult_mixed(load_avg, 2);
+	int coeff = div_fp(load_avg_2, add_mixed(load_avg_2, 1));
+	struct thread *curr = thread_current ();
+	struct list batch;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	mlfqs_epoch++;
+	decay_history[mlfqs_epoch % DECAY_HISTORY] = coeff;
+
+	/* Pull every ready thread out of the run queue, then put each
+	   back at its new priority. */
+	list_init (&batch);
+	if (!mlfqs_exempt (curr)) {
+		curr->recent_cpu = mlfqs_decay (curr->recent_cpu, coeff, curr->nice);
+		curr->recent_cpu_epoch = mlfqs_epoch;
+		curr->priority = mlfqs_calc_priority (curr);
+	}
+
+	for (int pri = PRI_MAX; pri >= PRI_MIN; pri--)
+		if (ready_rq.mask & (1ULL << pri)) {
+			list_splice (list_end (&batch), list_begin (&ready_rq.queues[pri]),
+					list_end (&ready_rq.queues[pri]));
+			list_splice (list_end (&batch),
+					list_begin (&ready_rq.batch_queues[pri]),
+					list_end (&ready_rq.batch_queues[pri]));
+		}
+	ready_rq.mask = 0;
+	ready_rq.cnt = 0;
+
+	while (!list_empty (&batch)) {
+		struct thread *t = list_entry (list_pop_front (&batch),
+				struct thread, elem);
+		if (!mlfqs_exempt (t)) {
+			t->recent_cpu = mlfqs_decay (t->recent_cpu, coeff, t->nice);
+			t->recent_cpu_epoch = mlfqs_epoch;
+			t->priority = mlfqs_calc_priority (t);
+		}
+		ready_push (t);
 	}
 }
 
+/* Every 4 ticks.  Within a second only the running thread's
+   recent_cpu changes, so it is the only priority to recompute. */
 void mlfqs_recalc_priority (void) {
-	//모든 스레드의 priority 값을 재계산한다
-	for (struct list_elem *e = list_begin(&all_list); e != list_end(&all_list); e = list_next(e)) {
-		mlfqs_priority(list_entry(e, struct thread, allelem));
+	mlfqs_priority (thread_current ());
+}
+
+/* Completely fair scheduler.
+
+   Every thread accumulates virtual runtime (vruntime): real run
+   time scaled down by its weight, which comes from its nice
+   value.  The ready thread with the least vruntime runs next.
+   Within one target latency (cfs_latency ticks) every ready
+   thread gets a slice proportional to its weight, but never less
+   than cfs_min_granularity ticks.  No priorities are recomputed,
+   so there is no per-second cost as with the MLFQS. */
+
+/* Weight of each nice value, -20 (index 0) to 20.  Neighbours
+   differ by about 1.25x, so one nice step is worth about 10% of
+   CPU time relative to a competing thread. */
+static const long cfs_nice_to_weight[NICE_MAX - NICE_MIN + 1] = {
+	/* -20 */ 88761, 71755, 56483, 46273, 36291,
+	/* -15 */ 29154, 23254, 18705, 14949, 11916,
+	/* -10 */  9548,  7620,  6100,  4904,  3906,
+	/*  -5 */  3121,  2501,  1991,  1586,  1277,
+	/*   0 */  1024,   820,   655,   526,   423,
+	/*   5 */   335,   272,   215,   172,   137,
+	/*  10 */   110,    87,    70,    56,    45,
+	/*  15 */    36,    29,    23,    18,    15,
+	/*  20 */    12,
+};
+
+/* Returns T's CFS weight. */
+static long
+cfs_weight (const struct thread *t) {
+	return cfs_nice_to_weight[t->nice - NICE_MIN];
+}
+
+/* Orders threads in a CFS tree by vruntime. */
+static bool
+cfs_less (const struct rb_elem *a_, const struct rb_elem *b_,
+		void *aux UNUSED) {
+	const struct thread *a = rb_entry (a_, struct thread, cfs_elem);
+	const struct thread *b = rb_entry (b_, struct thread, cfs_elem);
+
+	return a->vruntime < b->vruntime;
+}
+
+/* Returns the slice, in ticks, that CURR should get on RQ: its
+   share of the target latency, by weight, among itself and the
+   threads in RQ.  RQ must be locked. */
+static int64_t
+cfs_slice (const struct runqueue *rq, const struct thread *curr) {
+	long w = cfs_weight (curr);
+	int64_t slice = (int64_t) cfs_latency * w / (rq->cfs_load + w);
+
+	return slice < cfs_min_granularity ? cfs_min_granularity : slice;
+}
+
+/* Advances RQ's min_vruntime to the least of CURR's vruntime (if
+   CURR is not null) and the leftmost ready thread's, but never
+   backwards.  RQ must be locked. */
+static void
+cfs_update_min_vruntime (struct runqueue *rq, const struct thread *curr) {
+	struct rb_elem *left = rb_min (&rq->cfs_tree);
+	int64_t vr;
+
+	if (left != NULL) {
+		vr = rb_entry (left, struct thread, cfs_elem)->vruntime;
+		if (curr != NULL && curr->vruntime < vr)
+			vr = curr->vruntime;
+	} else if (curr != NULL)
+		vr = curr->vruntime;
+	else
+		return;
+	if (vr > rq->min_vruntime)
+		rq->min_vruntime = vr;
+}
+
+/* Charges one tick to CURR and asks for a
+   reschedule once CURR has used up its slice, or once it is more
+   than a slice ahead of the leftmost ready thread.  A batch
+   thread's slice is at least its quantum. */
+static void
+cfs_tick (struct thread *curr) {
+	struct runqueue *rq = &ready_rq;
+	struct rb_elem *left;
+	int64_t slice;
+	bool resched = false;
+
+	curr->vruntime += CFS_VR_UNIT * CFS_NICE_0_WEIGHT / cfs_weight (curr);
+
+	cfs_update_min_vruntime (rq, curr);
+	left = rb_min (&rq->cfs_tree);
+	if (left != NULL) {
+		slice = cfs_slice (rq, curr);
+		if (curr->sched_class == SCHED_BATCH && slice < curr->quantum)
+			slice = curr->quantum;
+		if (thread_ticks >= slice)
+			resched = true;
+		else if (thread_ticks >= (unsigned) cfs_min_granularity
+				&& curr->vruntime - rb_entry (left, struct thread, cfs_elem)->vruntime
+				> slice * CFS_VR_UNIT)
+			resched = true;
 	}
 
-}
\ No newline at end of file
+	if (resched)
+		intr_yield_on_return ();
+}
+
+/* Sets the vruntime of T, which is about to join RQ after being
+   blocked or created.  A thread that slept does not keep the
+   vruntime it had, which would let it monopolize the CPU, but
+   it gets half a target latency of credit so that interactive
+   threads run promptly when they wake up. */
+static void
+cfs_place (struct runqueue *rq, struct thread *t) {
+	int64_t vr = rq->min_vruntime - (int64_t) cfs_latency * CFS_VR_UNIT / 2;
+
+	if (t->vruntime < vr)
+		t->vruntime = vr;
+}
+
+/* Returns true if CURR should give way to the
+   leftmost ready thread: always if CURR is idle or a batch thread
+   and the leftmost is not, otherwise if CURR's vruntime is ahead
+   by more than the minimum granularity. */
+static bool
+cfs_should_preempt (const struct thread *curr) {
+	struct rb_elem *left = rb_min (&ready_rq.cfs_tree);
+	bool preempt = false;
+
+
+	if (left != NULL) {
+		const struct thread *t = rb_entry (left, struct thread, cfs_elem);
+		preempt = curr == idle_thread
+			|| (curr->sched_class == SCHED_BATCH
+				&& t->sched_class != SCHED_BATCH)
+			|| (curr->vruntime - t->vruntime
+				> (int64_t) cfs_min_granularity * CFS_VR_UNIT);
+	}
+	return preempt;
+}
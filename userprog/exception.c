@@ -2,8 +2,12 @@
 #include <inttypes.h>
 #include <stdio.h>
 #include "userprog/gdt.h"
+#include "userprog/process.h"
+#include "userprog/uaccess.h"
 #include "threads/interrupt.h"
+#include "threads/mmu.h"
 #include "threads/thread.h"
+#include "threads/vaddr.h"
 #include "intrinsic.h"
 
 /* Number of page faults processed. */
@@ -140,14 +144,31 @@ page_fault (struct intr_frame *f) {
 	write = (f->error_code & PF_W) != 0;
 	user = (f->error_code & PF_U) != 0;
 
+	/* Count page faults, including those handled below. */
+	page_fault_cnt++;
+
 #ifdef VM
 	/* For project 3 and later. */
 	if (vm_try_handle_fault (f, fault_addr, user, write, not_present))
 		return;
+#else
+	/* The first touch of a page of the executable, by the process
+	   or by a copy on its behalf. */
+	if (not_present && is_user_vaddr (fault_addr)
+			&& thread_current ()->pml4 != NULL
+			&& process_load_page (fault_addr))
+		return;
+
+	/* A write to a page that fork() left shared. */
+	if (pml4_cow_fault (thread_current ()->pml4, fault_addr, write,
+				not_present))
+		return;
 #endif
 
-	/* Count page faults. */
-	page_fault_cnt++;
+	/* A bad user pointer passed to a system call: make the copy
+	   that tripped over it fail. */
+	if (!user && uaccess_fixup (f))
+		return;
 
 	/* If the fault is true fault, show info and exit. */
 	printf ("Page fault at %p: %s error %s page in %s context.\n",
@@ -0,0 +1,139 @@
+/* Fast user-space mutexes.
+
+   A user program keeps its lock word in ordinary memory and only
+   calls into the kernel when it has to sleep (futex_wait) or when
+   it knows someone is sleeping (futex_wake).  Waiters are hashed
+   by the physical address of the word, so processes that share a
+   frame (for example through mmap) meet in the same queue no
+   matter at which virtual address each of them mapped it. */
+
+#include "userprog/futex.h"
+#include <debug.h>
+#include <hash.h>
+#include <list.h>
+#include <stdint.h>
+#include "threads/interrupt.h"
+#include "threads/mmu.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/uaccess.h"
+
+/* Number of wait-queue buckets.  Must be a power of 2. */
+#define FUTEX_BUCKETS 64
+
+/* A hash bucket: threads waiting on futexes that hash here.
+   Accessed only with interrupts off. */
+struct futex_bucket {
+	struct list waiters;        /* List of struct futex_waiter. */
+};
+
+/* A thread sleeping in futex_wait().  Lives on its stack. */
+struct futex_waiter {
+	struct list_elem elem;      /* Element in futex_bucket's list. */
+	uint64_t key;               /* Physical address of the futex word. */
+	struct thread *thread;      /* Sleeping thread. */
+};
+
+static struct futex_bucket buckets[FUTEX_BUCKETS];
+
+static bool futex_key (const int *uaddr, uint64_t *key, int **kaddr);
+static struct futex_bucket *futex_bucket (uint64_t key);
+
+/* Initializes the futex wait queues. */
+void
+futex_init (void) {
+	for (int i = 0; i < FUTEX_BUCKETS; i++)
+		list_init (&buckets[i].waiters);
+}
+
+/* If the int at user address UADDR still holds EXPECTED, sleeps
+   until a futex_wake() on the same word.  The check and the
+   enqueue are atomic with respect to futex_wake(), so a wakeup
+   that follows the caller's change of the word cannot be lost.
+   Returns 0 after being woken, or -1 if the word did not hold
+   EXPECTED or UADDR is not a mapped, aligned user address. */
+int
+futex_wait (int *uaddr, int expected) {
+	struct futex_waiter waiter;
+	struct futex_bucket *b;
+	enum intr_level old_level;
+	int *kaddr;
+
+	if (!futex_key (uaddr, &waiter.key, &kaddr))
+		return -1;
+	waiter.thread = thread_current ();
+	b = futex_bucket (waiter.key);
+
+	old_level = intr_disable ();
+	if (*(volatile int *) kaddr != expected) {
+		intr_set_level (old_level);
+		return -1;
+	}
+	list_push_back (&b->waiters, &waiter.elem);
+	thread_block ();
+	intr_set_level (old_level);
+	return 0;
+}
+
+/* Wakes up to CNT threads sleeping in futex_wait() on the int at
+   user address UADDR, oldest first.  Returns the number woken, or
+   -1 if UADDR is not a mapped, aligned user address. */
+int
+futex_wake (int *uaddr, int cnt) {
+	struct futex_bucket *b;
+	enum intr_level old_level;
+	struct list_elem *e;
+	uint64_t key;
+	int *kaddr;
+	int woken = 0;
+
+	if (!futex_key (uaddr, &key, &kaddr))
+		return -1;
+	b = futex_bucket (key);
+
+	old_level = intr_disable ();
+	for (e = list_begin (&b->waiters);
+			e != list_end (&b->waiters) && woken < cnt; ) {
+		struct futex_waiter *w = list_entry (e, struct futex_waiter, elem);
+		if (w->key == key) {
+			e = list_remove (e);
+			thread_unblock (w->thread);
+			woken++;
+		} else
+			e = list_next (e);
+	}
+	if (woken > 0)
+		check_preemption ();
+	intr_set_level (old_level);
+	return woken;
+}
+
+/* Translates user address UADDR in the current process into the
+   physical address *KEY that identifies the futex and the kernel
+   address *KADDR through which it can be read.  Returns false if
+   UADDR is misaligned, not a user address or not mapped.  A page
+   not yet loaded is faulted in first. */
+static bool
+futex_key (const int *uaddr, uint64_t *key, int **kaddr) {
+	uint64_t *pml4 = thread_current ()->pml4;
+	int value;
+	int *k;
+
+	if (uaddr == NULL || (uintptr_t) uaddr % sizeof (int) != 0
+			|| !is_user_vaddr (uaddr) || pml4 == NULL
+			|| !copy_from_user (&value, uaddr, sizeof value))
+		return false;
+	k = pml4_get_page (pml4, uaddr);
+	if (k == NULL)
+		return false;
+	*kaddr = k;
+	*key = vtop (k);
+	return true;
+}
+
+/* Returns the bucket for futex KEY. */
+static struct futex_bucket *
+futex_bucket (uint64_t key) {
+	return &buckets[hash_bytes (&key, sizeof key) & (FUTEX_BUCKETS - 1)];
+}
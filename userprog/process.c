@@ -10,13 +10,16 @@
 #include "filesys/directory.h"
 #include "filesys/file.h"
 #include "filesys/filesys.h"
+#include "filesys/text-cache.h"
 #include "threads/flags.h"
 #include "threads/init.h"
 #include "threads/interrupt.h"
+#include "threads/malloc.h"
 #include "threads/palloc.h"
 #include "threads/thread.h"
 #include "threads/mmu.h"
 #include "threads/vaddr.h"
+#include "userprog/uaccess.h"
 #include "intrinsic.h"
 #ifdef VM
 #include "vm/vm.h"
@@ -26,6 +29,21 @@ static void process_cleanup (void);
 static bool load (const char *file_name, struct intr_frame *if_);
 static void initd (void *f_name);
 static void __do_fork (void *);
+static void spawnd (void *);
+static bool push_args (struct intr_frame *if_, const char *args, size_t len,
+		int argc);
+
+/* A PT_LOAD segment of the running executable.  load() only
+ * records it; process_load_page() maps its pages as they are first
+ * touched. */
+struct segment {
+	struct list_elem elem;              /* Element in thread's segments. */
+	uint8_t *upage;                     /* First user page. */
+	size_t page_cnt;                    /* Number of pages. */
+	off_t ofs;                          /* File offset of UPAGE. */
+	size_t read_bytes;                  /* Bytes from the file; the rest is 0. */
+	bool writable;
+};
 
 /* General process initializer for initd and other process. */
 static void
@@ -71,46 +89,65 @@ initd (void *f_name) {
 	NOT_REACHED ();
 }
 
+/* Handed from process_fork() to __do_fork(), on the parent's
+ * stack. */
+struct fork_args {
+	struct thread *parent;
+	struct intr_frame *parent_if;       /* Parent's user context. */
+	struct semaphore done;              /* Upped once the child is set up. */
+	bool success;
+};
+
 /* Clones the current process as `name`. Returns the new process's thread id, or
- * TID_ERROR if the thread cannot be created. */
+ * TID_ERROR if the thread cannot be created.  Does not return until the child
+ * has its copy of the address space. */
 tid_t
-process_fork (const char *name, struct intr_frame *if_ UNUSED) {
+process_fork (const char *name, struct intr_frame *if_) {
+	struct fork_args args = {
+		.parent = thread_current (),
+		.parent_if = if_,
+		.success = false,
+	};
+	tid_t tid;
+
+	sema_init (&args.done, 0);
+
 	/* Clone current thread to new thread.*/
-	return thread_create (name,
-			PRI_DEFAULT, __do_fork, thread_current ());
+	tid = thread_create (name, PRI_DEFAULT, __do_fork, &args);
+	if (tid == TID_ERROR)
+		return TID_ERROR;
+	sema_down (&args.done);
+	return args.success ? tid : TID_ERROR;
 }
 
-#ifndef VM
-/* Duplicate the parent's address space by passing this function to the
- * pml4_for_each. This is only for the project 2. */
+/* Shares the parent's page at VA, whose entry is PTE, with the child by
+ * passing this function to the pml4_for_each.  Nothing is copied: a writable
+ * page becomes read-only and copy-on-write (PTE_COW) in both page tables, and
+ * the first write through either breaks the sharing (pml4_break_cow()).
+ *
+ * The parent sleeps in process_fork() meanwhile, and reloads CR3, which
+ * flushes its stale writable TLB entries, when it runs again. */
 static bool
-duplicate_pte (uint64_t *pte, void *va, void *aux) {
+duplicate_pte (uint64_t *pte, void *va, void *aux UNUSED) {
 	struct thread *current = thread_current ();
-	struct thread *parent = (struct thread *) aux;
-	void *parent_page;
-	void *newpage;
-	bool writable;
-
-	/* 1. TODO: If the parent_page is kernel page, then return immediately. */
+	uint64_t *child_pte;
 
-	/* 2. Resolve VA from the parent's page map level 4. */
-	parent_page = pml4_get_page (parent->pml4, va);
+	/* 1. Kernel pages are in every page table already. */
+	if (is_kern_pte (pte) || !is_user_vaddr (va))
+		return true;
 
-	/* 3. TODO: Allocate new PAL_USER page for the child and set result to
-	 *    TODO: NEWPAGE. */
+	/* 2. Write-protect the parent's page. */
+	if (*pte & PTE_W)
+		*pte = (*pte & ~PTE_W) | PTE_COW;
 
-	/* 4. TODO: Duplicate parent's page to the new page and
-	 *    TODO: check whether parent's page is writable or not (set WRITABLE
-	 *    TODO: according to the result). */
-
-	/* 5. Add new page to child's page table at address VA with WRITABLE
-	 *    permission. */
-	if (!pml4_set_page (current->pml4, va, newpage, writable)) {
-		/* 6. TODO: if fail to insert page, do error handling. */
-	}
+	/* 3. Map the same frame in the child, which takes a reference. */
+	child_pte = pml4e_walk (current->pml4, (uint64_t) va, 1);
+	if (child_pte == NULL)
+		return false;
+	*child_pte = *pte & ~PTE_A;
+	palloc_page_ref (ptov (PTE_ADDR (*pte)));
 	return true;
 }
-#endif
 
 /* A thread function that copies parent's execution context.
  * Hint) parent->tf does not hold the userland context of the process.
@@ -119,14 +156,13 @@ duplicate_pte (uint64_t *pte, void *va, void *aux) {
 static void
 __do_fork (void *aux) {
 	struct intr_frame if_;
-	struct thread *parent = (struct thread *) aux;
+	struct fork_args *args = aux;
+	struct thread *parent = args->parent;
 	struct thread *current = thread_current ();
-	/* TODO: somehow pass the parent_if. (i.e. process_fork()'s if_) */
-	struct intr_frame *parent_if;
-	bool succ = true;
 
-	/* 1. Read the cpu context to local stack. */
-	memcpy (&if_, parent_if, sizeof (struct intr_frame));
+	/* 1. Read the cpu context to local stack.  The child returns 0. */
+	memcpy (&if_, args->parent_if, sizeof (struct intr_frame));
+	if_.R.rax = 0;
 
 	/* 2. Duplicate PT */
 	current->pml4 = pml4_create();
@@ -138,26 +174,167 @@ __do_fork (void *aux) {
 	supplemental_page_table_init (&current->spt);
 	if (!supplemental_page_table_copy (&current->spt, &parent->spt))
 		goto error;
-#else
+#endif
 	if (!pml4_for_each (parent->pml4, duplicate_pte, parent))
 		goto error;
-#endif
 
-	/* TODO: Your code goes here.
-	 * TODO: Hint) To duplicate the file object, use `file_duplicate`
-	 * TODO:       in include/filesys/file.h. Note that parent should not return
-	 * TODO:       from the fork() until this function successfully duplicates
-	 * TODO:       the resources of parent.*/
+	/* 3. Share the executable, and the parts of it not mapped yet. */
+	if (parent->exec_file != NULL) {
+		current->exec_file = file_duplicate (parent->exec_file);
+		if (current->exec_file == NULL)
+			goto error;
+	}
+	for (struct list_elem *e = list_begin (&parent->segments);
+			e != list_end (&parent->segments); e = list_next (e)) {
+		struct segment *seg = malloc (sizeof *seg);
+		if (seg == NULL)
+			goto error;
+		*seg = *list_entry (e, struct segment, elem);
+		list_push_back (&current->segments, &seg->elem);
+	}
 
 	process_init ();
 
+	/* ARGS lives on the parent's stack; it is gone once the parent wakes. */
+	args->success = true;
+	sema_up (&args->done);
+
 	/* Finally, switch to the newly created process. */
-	if (succ)
-		do_iret (&if_);
+	do_iret (&if_);
 error:
+	sema_up (&args->done);
 	thread_exit ();
 }
 
+/* Handed from process_spawn() to spawnd(), in a page of its own.
+ * The path and then each argument, null-terminated, follow
+ * back to back in ARGS. */
+struct spawn_args {
+	struct semaphore done;              /* Upped once the child is loaded. */
+	bool success;
+	int argc;
+	size_t args_len;                    /* Bytes of ARGS in use. */
+	char args[];
+};
+
+/* Starts the program at user string UPATH in a new process, with the
+ * null-terminated user array of strings UARGV as its arguments (none if
+ * null).  Unlike fork() then exec(), no address space is built only to be
+ * torn down.  Returns the new process's thread id once it
+ * has loaded, or TID_ERROR if anything is bad or the load fails. */
+tid_t
+process_spawn (const char *upath, char *const *uargv) {
+	struct spawn_args *sa;
+	size_t room;
+	tid_t tid = TID_ERROR;
+	int len;
+
+	sa = palloc_get_page (PAL_ZERO);
+	if (sa == NULL)
+		return TID_ERROR;
+	sema_init (&sa->done, 0);
+	room = PGSIZE - sizeof *sa;
+
+	len = strncpy_from_user (sa->args, upath, room);
+	if (len <= 0)
+		goto done;
+	sa->args_len = len + 1;
+
+	while (uargv != NULL) {
+		char *uarg;
+
+		if (!copy_from_user (&uarg, &uargv[sa->argc], sizeof uarg))
+			goto done;
+		if (uarg == NULL)
+			break;
+		len = strncpy_from_user (sa->args + sa->args_len, uarg,
+				room - sa->args_len);
+		if (len < 0)
+			goto done;
+		sa->args_len += len + 1;
+		sa->argc++;
+	}
+
+	tid = thread_create (sa->args, PRI_DEFAULT, spawnd, sa);
+	if (tid != TID_ERROR) {
+		sema_down (&sa->done);
+		if (!sa->success)
+			tid = TID_ERROR;
+	}
+
+done:
+	palloc_free_page (sa);
+	return tid;
+}
+
+/* A thread function that loads the program process_spawn() asked for
+ * into the new process and starts it. */
+static void
+spawnd (void *aux) {
+	struct spawn_args *sa = aux;
+	size_t path_len = strlen (sa->args) + 1;
+	struct intr_frame if_;
+	bool success;
+
+	memset (&if_, 0, sizeof if_);
+	if_.ds = if_.es = if_.ss = SEL_UDSEG;
+	if_.cs = SEL_UCSEG;
+	if_.eflags = FLAG_IF | FLAG_MBS;
+
+#ifdef VM
+	supplemental_page_table_init (&thread_current ()->spt);
+#endif
+	process_init ();
+
+	success = load (sa->args, &if_)
+		&& push_args (&if_, sa->args + path_len, sa->args_len - path_len,
+				sa->argc);
+
+	/* SA belongs to the parent, which frees it once it wakes. */
+	sa->success = success;
+	sema_up (&sa->done);
+
+	if (success)
+		do_iret (&if_);
+	thread_exit ();
+}
+
+/* Copies the ARGC null-terminated strings in the LEN bytes at ARGS
+ * onto the user stack in IF_, followed by the argv array, and passes
+ * argc and argv to the program's entry point.  The whole lot must fit
+ * in the stack's one page.  Returns true if successful. */
+static bool
+push_args (struct intr_frame *if_, const char *args, size_t len, int argc) {
+	uintptr_t sp = if_->rsp;
+	char **argv;
+	char *arg;
+	int i;
+
+	if (ROUND_UP (len, 16) + (argc + 2) * sizeof (char *) + 16 > PGSIZE)
+		return false;
+
+	sp -= len;
+	arg = memcpy ((void *) sp, args, len);
+
+	/* argv is 16-byte aligned, so that the fake return address
+	 * leaves %rsp as a call would. */
+	sp = ROUND_DOWN (sp - (argc + 1) * sizeof (char *), 16);
+	argv = (char **) sp;
+	for (i = 0; i < argc; i++) {
+		argv[i] = arg;
+		arg += strlen (arg) + 1;
+	}
+	argv[argc] = NULL;
+
+	sp -= sizeof (void *);
+	*(void **) sp = NULL;
+
+	if_->rsp = sp;
+	if_->R.rdi = argc;
+	if_->R.rsi = (uint64_t) argv;
+	return true;
+}
+
 /* Switch the current execution context to the f_name.
  * Returns -1 on fail. */
 int
@@ -228,6 +405,12 @@ process_cleanup (void) {
 	supplemental_page_table_kill (&curr->spt);
 #endif
 
+	while (!list_empty (&curr->segments))
+		free (list_entry (list_pop_front (&curr->segments),
+					struct segment, elem));
+	file_close (curr->exec_file);
+	curr->exec_file = NULL;
+
 	uint64_t *pml4;
 	/* Destroy the current process's page directory and switch back
 	 * to the kernel-only page directory. */
@@ -341,6 +524,7 @@ load (const char *file_name, struct intr_frame *if_) {
 		printf ("load: %s: open failed\n", file_name);
 		goto done;
 	}
+	file_deny_write (file);
 
 	/* Read and verify executable header. */
 	if (file_read (file, &ehdr, sizeof ehdr) != sizeof ehdr
@@ -420,8 +604,12 @@ load (const char *file_name, struct intr_frame *if_) {
 	success = true;
 
 done:
-	/* We arrive here whether the load is successful or not. */
-	file_close (file);
+	/* We arrive here whether the load is successful or not.  The
+	 * pages are read in later, so a loaded executable stays open. */
+	if (success)
+		t->exec_file = file;
+	else
+		file_close (file);
 	return success;
 }
 
@@ -490,46 +678,102 @@ static bool install_page (void *upage, void *kpage, bool writable);
  * The pages initialized by this function must be writable by the
  * user process if WRITABLE is true, read-only otherwise.
  *
+ * Nothing is read yet: the segment is recorded, and its pages are
+ * read in by process_load_page() when first touched.
+ *
  * Return true if successful, false if a memory allocation error
- * or disk read error occurs. */
+ * occurs or the segment overlaps one already loaded. */
 static bool
-load_segment (struct file *file, off_t ofs, uint8_t *upage,
+load_segment (struct file *file UNUSED, off_t ofs, uint8_t *upage,
 		uint32_t read_bytes, uint32_t zero_bytes, bool writable) {
+	struct thread *t = thread_current ();
+	size_t page_cnt = (read_bytes + zero_bytes) / PGSIZE;
+	struct segment *seg;
+	struct list_elem *e;
+
 	ASSERT ((read_bytes + zero_bytes) % PGSIZE == 0);
 	ASSERT (pg_ofs (upage) == 0);
 	ASSERT (ofs % PGSIZE == 0);
 
-	file_seek (file, ofs);
-	while (read_bytes > 0 || zero_bytes > 0) {
-		/* Do calculate how to fill this page.
-		 * We will read PAGE_READ_BYTES bytes from FILE
-		 * and zero the final PAGE_ZERO_BYTES bytes. */
-		size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
-		size_t page_zero_bytes = PGSIZE - page_read_bytes;
-
-		/* Get a page of memory. */
-		uint8_t *kpage = palloc_get_page (PAL_USER);
-		if (kpage == NULL)
+	for (e = list_begin (&t->segments); e != list_end (&t->segments);
+			e = list_next (e)) {
+		seg = list_entry (e, struct segment, elem);
+		if (upage < seg->upage + seg->page_cnt * PGSIZE
+				&& seg->upage < upage + page_cnt * PGSIZE)
 			return false;
+	}
 
-		/* Load this page. */
-		if (file_read (file, kpage, page_read_bytes) != (int) page_read_bytes) {
-			palloc_free_page (kpage);
-			return false;
+	seg = malloc (sizeof *seg);
+	if (seg == NULL)
+		return false;
+	*seg = (struct segment) {
+		.upage = upage,
+		.page_cnt = page_cnt,
+		.ofs = ofs,
+		.read_bytes = read_bytes,
+		.writable = writable,
+	};
+	list_push_back (&t->segments, &seg->elem);
+	return true;
+}
+
+/* Maps the page of the running executable that contains user
+ * address UADDR, which has not been touched before.  A page read
+ * whole from the file comes from the text cache, shared with every
+ * process running the same executable: read-only, or copy-on-write
+ * (PTE_COW) if its segment is writable.  A page that is partly or
+ * entirely zeros gets a frame of its own.  Returns false if UADDR is
+ * in no segment, or memory or the disk fails. */
+bool
+process_load_page (const void *uaddr) {
+	struct thread *t = thread_current ();
+	uint8_t *upage = pg_round_down (uaddr);
+	struct segment *seg = NULL;
+	struct list_elem *e;
+	size_t done, page_read_bytes;
+	uint8_t *kpage;
+
+	for (e = list_begin (&t->segments); e != list_end (&t->segments);
+			e = list_next (e)) {
+		struct segment *s = list_entry (e, struct segment, elem);
+		if (upage >= s->upage && upage < s->upage + s->page_cnt * PGSIZE) {
+			seg = s;
+			break;
 		}
-		memset (kpage + page_read_bytes, 0, page_zero_bytes);
+	}
+	if (seg == NULL || pml4_get_page (t->pml4, upage) != NULL)
+		return false;
+
+	done = upage - seg->upage;
+	page_read_bytes = seg->read_bytes > done ? seg->read_bytes - done : 0;
+	if (page_read_bytes > PGSIZE)
+		page_read_bytes = PGSIZE;
 
-		/* Add the page to the process's address space. */
-		if (!install_page (upage, kpage, writable)) {
-			printf("fail\n");
+	if (page_read_bytes == PGSIZE) {
+		kpage = text_cache_get (file_get_inode (t->exec_file), seg->ofs + done);
+		if (kpage == NULL)
+			return false;
+		if (!pml4_set_page (t->pml4, upage, kpage, false)) {
 			palloc_free_page (kpage);
 			return false;
 		}
+		if (seg->writable)
+			*pml4e_walk (t->pml4, (uint64_t) upage, false) |= PTE_COW;
+		return true;
+	}
 
-		/* Advance. */
-		read_bytes -= page_read_bytes;
-		zero_bytes -= page_zero_bytes;
-		upage += PGSIZE;
+	while ((kpage = palloc_get_page (PAL_USER)) == NULL)
+		if (!text_cache_shrink ())
+			return false;
+	if (file_read_at (t->exec_file, kpage, page_read_bytes, seg->ofs + done)
+			!= (off_t) page_read_bytes) {
+		palloc_free_page (kpage);
+		return false;
+	}
+	memset (kpage + page_read_bytes, 0, PGSIZE - page_read_bytes);
+	if (!pml4_set_page (t->pml4, upage, kpage, seg->writable)) {
+		palloc_free_page (kpage);
+		return false;
 	}
 	return true;
 }
@@ -1,16 +1,79 @@
 #include "userprog/syscall.h"
+#include <inttypes.h>
 #include <stdio.h>
+#include <string.h>
 #include <syscall-nr.h>
+#include <syscall-stat.h>
+#include "devices/input.h"
+#include "threads/init.h"
 #include "threads/interrupt.h"
 #include "threads/thread.h"
 #include "threads/loader.h"
 #include "userprog/gdt.h"
+#include "userprog/futex.h"
+#include "userprog/process.h"
+#include "userprog/uaccess.h"
 #include "threads/flags.h"
 #include "intrinsic.h"
 
 void syscall_entry (void);
 void syscall_handler (struct intr_frame *);
 
+/* A system call implementation.  Takes its arguments from F's
+   registers, leaves its result in F->R.rax, and returns false if
+   the call failed, for the error count. */
+typedef bool syscall_func (struct intr_frame *f);
+
+static syscall_func sys_halt, sys_exit, sys_fork, sys_spawn;
+static syscall_func sys_read, sys_write;
+static syscall_func sys_futex_wait, sys_futex_wake, sys_sched_setclass;
+static syscall_func sys_intr_stat, sys_sysstat;
+
+/* System call table, indexed by SYS_* number.  A null FUNC is
+   not implemented yet. */
+static const struct syscall {
+	syscall_func *func;
+	const char *name;
+} syscalls[SYS_CNT] = {
+	[SYS_HALT] = { sys_halt, "halt" },
+	[SYS_EXIT] = { sys_exit, "exit" },
+	[SYS_FORK] = { sys_fork, "fork" },
+	[SYS_EXEC] = { NULL, "exec" },
+	[SYS_WAIT] = { NULL, "wait" },
+	[SYS_CREATE] = { NULL, "create" },
+	[SYS_REMOVE] = { NULL, "remove" },
+	[SYS_OPEN] = { NULL, "open" },
+	[SYS_FILESIZE] = { NULL, "filesize" },
+	[SYS_READ] = { sys_read, "read" },
+	[SYS_WRITE] = { sys_write, "write" },
+	[SYS_SEEK] = { NULL, "seek" },
+	[SYS_TELL] = { NULL, "tell" },
+	[SYS_CLOSE] = { NULL, "close" },
+	[SYS_MMAP] = { NULL, "mmap" },
+	[SYS_MUNMAP] = { NULL, "munmap" },
+	[SYS_CHDIR] = { NULL, "chdir" },
+	[SYS_MKDIR] = { NULL, "mkdir" },
+	[SYS_READDIR] = { NULL, "readdir" },
+	[SYS_ISDIR] = { NULL, "isdir" },
+	[SYS_INUMBER] = { NULL, "inumber" },
+	[SYS_SYMLINK] = { NULL, "symlink" },
+	[SYS_DUP2] = { NULL, "dup2" },
+	[SYS_MOUNT] = { NULL, "mount" },
+	[SYS_UMOUNT] = { NULL, "umount" },
+	[SYS_FUTEX_WAIT] = { sys_futex_wait, "futex_wait" },
+	[SYS_FUTEX_WAKE] = { sys_futex_wake, "futex_wake" },
+	[SYS_INTR_STAT] = { sys_intr_stat, "intr_stat" },
+	[SYS_SCHED_SETCLASS] = { sys_sched_setclass, "sched_setclass" },
+	[SYS_SYSSTAT] = { sys_sysstat, "sysstat" },
+	[SYS_SPAWN] = { sys_spawn, "spawn" },
+};
+
+/* Per-call accounting.  The name field is filled in on the way
+   out, by sys_sysstat(). */
+static struct syscall_stat syscall_stats[SYS_CNT];
+
+static void syscall_account (uint64_t nr, bool ok, uint64_t cycles);
+
 /* System call.
  *
  * Previously system call services was handled by the interrupt handler
@@ -35,12 +98,231 @@ syscall_init (void) {
 	 * mode stack. Therefore, we masked the FLAG_FL. */
 	write_msr(MSR_SYSCALL_MASK,
 			FLAG_IF | FLAG_TF | FLAG_DF | FLAG_IOPL | FLAG_AC | FLAG_NT);
+
+	futex_init ();
 }
 
-/* The main system call interface */
+/* The main system call interface.  The file I/O calls are the
+   hottest, so they are called directly, which the compiler can
+   inline, and only the rest go through the table.  A call that is
+   unknown or not implemented yet fails with -1. */
 void
-syscall_handler (struct intr_frame *f UNUSED) {
-	// TODO: Your implementation goes here.
-	printf ("system call!\n");
+syscall_handler (struct intr_frame *f) {
+	uint64_t nr = f->R.rax;
+	uint64_t start = rdtsc ();
+	bool ok;
+
+	switch (nr) {
+		case SYS_READ:
+			ok = sys_read (f);
+			break;
+		case SYS_WRITE:
+			ok = sys_write (f);
+			break;
+		default:
+			if (nr < SYS_CNT && syscalls[nr].func != NULL)
+				ok = syscalls[nr].func (f);
+			else {
+				f->R.rax = -1;
+				ok = false;
+			}
+			break;
+	}
+	syscall_account (nr, ok, rdtsc () - start);
+}
+
+/* Charges a call to system call NR that took CYCLES and, unless
+   OK, failed. */
+static void
+syscall_account (uint64_t nr, bool ok, uint64_t cycles) {
+	struct syscall_stat *s;
+	int bucket = cycles != 0 ? 63 - __builtin_clzll (cycles) : 0;
+
+	if (nr >= SYS_CNT)
+		return;
+	s = &syscall_stats[nr];
+	s->calls++;
+	if (!ok)
+		s->errors++;
+	s->cycles += cycles;
+	s->hist[bucket < SYSCALL_STAT_HIST_CNT ? bucket : SYSCALL_STAT_HIST_CNT - 1]++;
+}
+
+/* Prints the accounting of every system call that was made. */
+void
+syscall_print_stats (void) {
+	for (int nr = 0; nr < SYS_CNT; nr++) {
+		const struct syscall_stat *s = &syscall_stats[nr];
+
+		if (s->calls == 0)
+			continue;
+		printf ("Syscall %s: %'"PRIu64" calls, %'"PRIu64" errors, "
+				"%'"PRIu64" cycles average\n", syscalls[nr].name, s->calls,
+				s->errors, s->cycles / s->calls);
+		printf ("  log2 cycles:");
+		for (int i = 0; i < SYSCALL_STAT_HIST_CNT; i++)
+			if (s->hist[i] != 0)
+				printf (" %d:%"PRIu32, i, s->hist[i]);
+		printf ("\n");
+	}
+}
+
+/* halt().  Never returns, so it is not accounted. */
+static bool
+sys_halt (struct intr_frame *f UNUSED) {
+	power_off ();
+}
+
+/* exit(status).  Never returns, so it is not accounted. */
+static bool
+sys_exit (struct intr_frame *f) {
+	printf ("%s: exit(%d)\n", thread_name (), (int) f->R.rdi);
 	thread_exit ();
 }
+
+/* fork(thread_name).  Returns the child's pid, or -1; the child
+   returns 0.  The thread name is truncated as thread_create()
+   would. */
+static bool
+sys_fork (struct intr_frame *f) {
+	char name[64];
+	tid_t tid;
+
+	f->R.rax = -1;
+	if (strncpy_from_user (name, (const char *) f->R.rdi, sizeof name) < 0)
+		return false;
+	tid = process_fork (name, f);
+	f->R.rax = tid;
+	return tid != TID_ERROR;
+}
+
+/* spawn(file, argv).  Returns the child's pid, or -1
+   if an argument is bad or the program cannot be loaded. */
+static bool
+sys_spawn (struct intr_frame *f) {
+	tid_t tid = process_spawn ((const char *) f->R.rdi,
+			(char *const *) f->R.rsi);
+
+	f->R.rax = tid;
+	return tid != TID_ERROR;
+}
+
+/* read(fd, buffer, size).  Only the keyboard, fd 0, can be read
+   so far.  Keys are collected on the kernel stack and copied out
+   a piece at a time. */
+static bool
+sys_read (struct intr_frame *f) {
+	int fd = f->R.rdi;
+	uint8_t *ubuf = (uint8_t *) f->R.rsi;
+	unsigned size = f->R.rdx;
+	unsigned done = 0;
+	uint8_t buf[256];
+
+	if (fd != 0) {
+		f->R.rax = -1;
+		return false;
+	}
+	while (done < size) {
+		unsigned chunk = size - done < sizeof buf ? size - done : sizeof buf;
+		for (unsigned i = 0; i < chunk; i++)
+			buf[i] = input_getc ();
+		if (!copy_to_user (ubuf + done, buf, chunk)) {
+			f->R.rax = -1;
+			return false;
+		}
+		done += chunk;
+	}
+	f->R.rax = done;
+	return true;
+}
+
+/* write(fd, buffer, size).  Only the console, fd 1, can be
+   written so far.  The buffer goes out in pieces, but each piece
+   in one putbuf() call, so it is not interleaved with other
+   output. */
+static bool
+sys_write (struct intr_frame *f) {
+	int fd = f->R.rdi;
+	const uint8_t *ubuf = (const uint8_t *) f->R.rsi;
+	unsigned size = f->R.rdx;
+	unsigned done = 0;
+	char buf[256];
+
+	if (fd != 1) {
+		f->R.rax = -1;
+		return false;
+	}
+	while (done < size) {
+		unsigned chunk = size - done < sizeof buf ? size - done : sizeof buf;
+		if (!copy_from_user (buf, ubuf + done, chunk))
+			break;
+		putbuf (buf, chunk);
+		done += chunk;
+	}
+	f->R.rax = done;
+	return done == size;
+}
+
+/* futex_wait(addr, expected). */
+static bool
+sys_futex_wait (struct intr_frame *f) {
+	int ret = futex_wait ((int *) f->R.rdi, (int) f->R.rsi);
+
+	f->R.rax = ret;
+	return ret == 0;
+}
+
+/* futex_wake(addr, cnt). */
+static bool
+sys_futex_wake (struct intr_frame *f) {
+	int ret = futex_wake ((int *) f->R.rdi, (int) f->R.rsi);
+
+	f->R.rax = ret;
+	return ret >= 0;
+}
+
+/* sched_setclass(class). */
+static bool
+sys_sched_setclass (struct intr_frame *f) {
+	int ret = thread_set_class ((int) f->R.rdi);
+
+	f->R.rax = ret;
+	return ret >= 0;
+}
+
+/* intr_stat(vec, stat): copies interrupt VEC's accounting to
+   user STAT.  Returns 0, or -1 if VEC is not a vector or STAT is
+   bad. */
+static bool
+sys_intr_stat (struct intr_frame *f) {
+	int vec = f->R.rdi;
+	struct intr_stat stat;
+
+	f->R.rax = -1;
+	if (vec < 0 || vec > UINT8_MAX)
+		return false;
+	intr_get_stat (vec, &stat);
+	if (!copy_to_user ((void *) f->R.rsi, &stat, sizeof stat))
+		return false;
+	f->R.rax = 0;
+	return true;
+}
+
+/* sysstat(nr, stat): copies system call NR's accounting to user
+   STAT.  Returns 0, or -1 if NR is not a system call or STAT is
+   bad.  This call's own entry counts the calls before it. */
+static bool
+sys_sysstat (struct intr_frame *f) {
+	int nr = f->R.rdi;
+	struct syscall_stat stat;
+
+	f->R.rax = -1;
+	if (nr < 0 || nr >= SYS_CNT)
+		return false;
+	stat = syscall_stats[nr];
+	strlcpy (stat.name, syscalls[nr].name, sizeof stat.name);
+	if (!copy_to_user ((void *) f->R.rsi, &stat, sizeof stat))
+		return false;
+	f->R.rax = 0;
+	return true;
+}
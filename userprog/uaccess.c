@@ -0,0 +1,90 @@
+#include "userprog/uaccess.h"
+#include <stdint.h>
+#include "threads/vaddr.h"
+#include "userprog/gdt.h"
+
+/* Access to user memory from system calls.
+
+   The copies do not check that the user pages are mapped before
+   touching them.  They only check that the range lies below
+   KERN_BASE, which is cheap, and then go ahead.  If a user page
+   is missing or read-only, the CPU raises a page fault inside
+   uaccess-copy.S.  page_fault() first gives the VM system its chance
+   to bring the page in, and otherwise calls uaccess_fixup(),
+   which resumes the copy loop at its failure exit.  So a bulk
+   transfer costs one range check, not one page walk per page. */
+
+/* An __ex_table entry, emitted by uaccess-copy.S: if the instruction
+   at INSN faults, resume at FIXUP. */
+struct ex_entry {
+	uintptr_t insn;
+	uintptr_t fixup;
+};
+
+/* Bounds of the __ex_table section, from the linker script. */
+extern const struct ex_entry __start___ex_table[], __stop___ex_table[];
+
+size_t uaccess_copy (void *dst, const void *src, size_t n);
+long uaccess_strncpy (char *dst, const char *src, size_t n);
+
+/* Returns true if [UADDR, UADDR + SIZE) lies wholly in user
+   space. */
+static bool
+user_range_ok (const void *uaddr, size_t size) {
+	uintptr_t start = (uintptr_t) uaddr;
+
+	return start + size >= start && start + size <= KERN_BASE;
+}
+
+/* Copies SIZE bytes from user USRC to kernel DST.  Returns false
+   if USRC is not a user address or some page of it is not mapped,
+   in which case DST may have been partly written. */
+bool
+copy_from_user (void *dst, const void *usrc, size_t size) {
+	return user_range_ok (usrc, size) && uaccess_copy (dst, usrc, size) == 0;
+}
+
+/* Copies SIZE bytes from kernel SRC to user UDST.  Returns false
+   if UDST is not a user address or some page of it is not mapped
+   writable, in which case a prefix of UDST may have been
+   written. */
+bool
+copy_to_user (void *udst, const void *src, size_t size) {
+	return user_range_ok (udst, size) && uaccess_copy (udst, src, size) == 0;
+}
+
+/* Copies the null-terminated string at user USRC into DST, which
+   has room for SIZE bytes.  Returns the string's length, or -1
+   if USRC is bad or the string, with its null terminator, does
+   not fit in SIZE bytes. */
+int
+strncpy_from_user (char *dst, const char *usrc, size_t size) {
+	uintptr_t start = (uintptr_t) usrc;
+	long len;
+
+	if (start >= KERN_BASE)
+		return -1;
+	/* Never read past the top of user space. */
+	if (size > KERN_BASE - start)
+		size = KERN_BASE - start;
+	len = uaccess_strncpy (dst, usrc, size);
+	return len >= 0 && (size_t) len < size ? (int) len : -1;
+}
+
+/* Called by page_fault() for a fault in kernel mode.  If the
+   fault happened in one of the copy loops, redirects F to that
+   loop's failure exit and returns true.  Otherwise returns false:
+   the fault is a kernel bug. */
+bool
+uaccess_fixup (struct intr_frame *f) {
+	const struct ex_entry *e;
+
+	if (f->cs != SEL_KCSEG)
+		return false;
+	for (e = __start___ex_table; e < __stop___ex_table; e++)
+		if (e->insn == f->rip) {
+			f->rip = e->fixup;
+			return true;
+		}
+	return false;
+}
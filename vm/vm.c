@@ -1,6 +1,7 @@
 /* vm.c: Generic interface for virtual memory objects. */
 
 #include "threads/malloc.h"
+#include "threads/mmu.h"
 #include "vm/vm.h"
 #include "vm/inspect.h"
 
@@ -134,6 +135,12 @@ vm_try_handle_fault (struct intr_frame *f UNUSED, void *addr UNUSED,
 		bool user UNUSED, bool write UNUSED, bool not_present UNUSED) {
 	struct supplemental_page_table *spt UNUSED = &thread_current ()->spt;
 	struct page *page = NULL;
+
+	/* A write to a frame that fork() left shared: copy it, or take
+	 * it back if we are the last sharer. */
+	if (pml4_cow_fault (thread_current ()->pml4, addr, write, not_present))
+		return true;
+
 	/* TODO: Validate the fault */
 	/* TODO: Your code goes here */
 
@@ -180,6 +187,9 @@ supplemental_page_table_init (struct supplemental_page_table *spt UNUSED) {
 bool
 supplemental_page_table_copy (struct supplemental_page_table *dst UNUSED,
 		struct supplemental_page_table *src UNUSED) {
+	/* The frames themselves are shared copy-on-write through the page
+	 * table; see duplicate_pte() in userprog/process.c. */
+	return true;
 }
 
 /* Free the resource hold by the supplemental page table */